@@ -0,0 +1,324 @@
+// compares two runs of a benchmark saved with --json, reporting every case they have in common, and exits with a status
+// of 1 if any case is significantly slower in the second run (0 otherwise, or 2 on errors)
+// a case is significantly slower if it is slower by at least the threshold (relative to the median) and the samples of
+// both runs are different with the given confidence, according to a Mann-Whitney U test (which doesn't assume any
+// particular distribution of the samples, so it isn't fooled by the occasional outlier)
+// build: cc -O2 -o comparator benchmark/comparator.c -lm
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+
+// a parsed JSON value: only the parts that the comparator needs are kept (numbers, strings, and the structure)
+struct json_value {
+  enum {JSON_NULL, JSON_BOOLEAN, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT} type;
+  double number;
+  char * string;
+  unsigned count;
+  char ** keys;                  // for objects
+  struct json_value * items;     // for arrays and objects
+};
+
+struct parser {
+  const char * text;
+  int error;
+};
+
+struct run_case {
+  const char * name;
+  double median;
+  unsigned count;
+  double * samples;
+};
+
+static struct json_value * load_file(const char *);
+static void parse_value(struct parser *, struct json_value *, unsigned);
+static char * parse_string(struct parser *);
+static void skip_spaces(struct parser *);
+static void free_value(struct json_value *);
+static const struct json_value * member(const struct json_value *, const char *);
+static unsigned load_cases(const struct json_value *, struct run_case **);
+static double mann_whitney(const double *, unsigned, const double *, unsigned);
+static int compare_ranked(const void *, const void *);
+
+int main (int argc, char ** argv) {
+  double threshold = 0.05, alpha = 0.01;
+  const char * files[2] = {NULL, NULL};
+  int current, file_count = 0;
+  for (current = 1; current < argc; current ++) {
+    char * end;
+    if (!strncmp(argv[current], "--threshold=", 12)) {
+      threshold = strtod(argv[current] + 12, &end) / 100;
+      if (*end || !(threshold >= 0)) file_count = 3;
+    } else if (!strncmp(argv[current], "--alpha=", 8)) {
+      alpha = strtod(argv[current] + 8, &end);
+      if (*end || !(alpha > 0) || !(alpha < 1)) file_count = 3;
+    } else if (file_count < 2)
+      files[file_count ++] = argv[current];
+    else
+      file_count = 3;
+  }
+  if (file_count != 2) {
+    fprintf(stderr, "usage: %s [options] baseline.json candidate.json\n"
+                    "  --threshold=P     smallest slowdown that counts as a regression, in percent (default: 5)\n"
+                    "  --alpha=A         significance level for the Mann-Whitney U test (default: 0.01)\n", *argv);
+    return 2;
+  }
+  struct json_value * runs[2];
+  struct run_case * cases[2];
+  unsigned counts[2], run;
+  for (run = 0; run < 2; run ++) {
+    if (!(runs[run] = load_file(files[run]))) return 2;
+    counts[run] = load_cases(runs[run], cases + run);
+    if (!counts[run]) {
+      fprintf(stderr, "%s: no benchmark cases found\n", files[run]);
+      return 2;
+    }
+  }
+  for (run = 0; run < 2; run ++) {
+    const struct json_value * model = member(member(runs[run], "environment"), "cpu_model");
+    const struct json_value * compiler = member(member(runs[run], "environment"), "compiler");
+    const struct json_value * flags = member(member(runs[run], "environment"), "flags");
+    printf("# %s: %s; %s %s\n", run ? "candidate" : "baseline", (model && model -> string) ? model -> string : "unknown CPU",
+           (compiler && compiler -> string) ? compiler -> string : "unknown compiler", (flags && flags -> string) ? flags -> string : "");
+  }
+  printf("%-28s %12s %12s %9s %9s  %s\n", "case", "baseline", "candidate", "change", "p-value", "result");
+  unsigned first, second, regressions = 0;
+  for (first = 0; first < counts[0]; first ++) {
+    const struct run_case * baseline = cases[0] + first;
+    for (second = 0; second < counts[1]; second ++) if (!strcmp(cases[1][second].name, baseline -> name)) break;
+    if (second == counts[1]) continue;
+    const struct run_case * candidate = cases[1] + second;
+    double change = candidate -> median / baseline -> median - 1;
+    double p = mann_whitney(baseline -> samples, baseline -> count, candidate -> samples, candidate -> count);
+    const char * verdict = "same";
+    if ((p < alpha) && (fabs(change) >= threshold)) {
+      verdict = (change > 0) ? "SLOWER" : "faster";
+      if (change > 0) regressions ++;
+    }
+    printf("%-28s %12.3f %12.3f %+8.2f%% %9.4f  %s\n", baseline -> name, baseline -> median, candidate -> median,
+           change * 100, p, verdict);
+  }
+  printf("# %u significant slowdown%s (threshold: %g%%, alpha: %g)\n", regressions, (regressions == 1) ? "" : "s",
+         threshold * 100, alpha);
+  for (run = 0; run < 2; run ++) {
+    for (current = 0; current < (int) counts[run]; current ++) free(cases[run][current].samples);
+    free(cases[run]);
+    free_value(runs[run]);
+    free(runs[run]);
+  }
+  return !!regressions;
+}
+
+static struct json_value * load_file (const char * filename) {
+  FILE * file = fopen(filename, "rb");
+  if (!file) {
+    fprintf(stderr, "could not open %s\n", filename);
+    return NULL;
+  }
+  size_t size = 0, capacity = 0;
+  char * text = NULL;
+  for (;;) {
+    if ((capacity - size) < 4096) {
+      char * grown = realloc(text, capacity += 65536);
+      if (!grown) goto fail;
+      text = grown;
+    }
+    size_t bytes = fread(text + size, 1, capacity - size - 1, file);
+    if (!bytes) break;
+    size += bytes;
+  }
+  if (ferror(file)) goto fail;
+  fclose(file);
+  text[size] = 0;
+  struct json_value * value = calloc(1, sizeof *value);
+  struct parser parser = {.text = text, .error = !value};
+  if (value) parse_value(&parser, value, 0);
+  skip_spaces(&parser);
+  if (parser.error || *parser.text) {
+    fprintf(stderr, "%s: invalid JSON\n", filename);
+    if (value) free_value(value);
+    free(value);
+    value = NULL;
+  }
+  free(text);
+  return value;
+  fail:
+  fprintf(stderr, "could not read %s\n", filename);
+  fclose(file);
+  free(text);
+  return NULL;
+}
+
+static void parse_value (struct parser * parser, struct json_value * value, unsigned depth) {
+  // on errors, parser -> error is set, and value is left in a state that free_value can still handle
+  memset(value, 0, sizeof *value);
+  skip_spaces(parser);
+  if (depth > 64) {
+    parser -> error = 1;
+    return;
+  }
+  char first = *parser -> text;
+  if ((first == '[') || (first == '{')) {
+    value -> type = (first == '[') ? JSON_ARRAY : JSON_OBJECT;
+    char last = (first == '[') ? ']' : '}';
+    parser -> text ++;
+    skip_spaces(parser);
+    if (*parser -> text == last) {
+      parser -> text ++;
+      return;
+    }
+    for (;;) {
+      struct json_value * items = realloc(value -> items, (value -> count + 1) * sizeof *items);
+      char ** keys = (value -> type == JSON_OBJECT) ? realloc(value -> keys, (value -> count + 1) * sizeof *keys) : NULL;
+      if (items) value -> items = items;
+      if (keys) value -> keys = keys;
+      if (!items || ((value -> type == JSON_OBJECT) && !keys)) {
+        parser -> error = 1;
+        return;
+      }
+      if (value -> type == JSON_OBJECT) {
+        skip_spaces(parser);
+        keys[value -> count] = parse_string(parser);
+        skip_spaces(parser);
+        if (!keys[value -> count] || (*parser -> text != ':')) {
+          free(keys[value -> count]);
+          parser -> error = 1;
+          return;
+        }
+        parser -> text ++;
+      }
+      parse_value(parser, items + value -> count ++, depth + 1);
+      if (parser -> error) return;
+      skip_spaces(parser);
+      if (*parser -> text == ',')
+        parser -> text ++;
+      else if (*parser -> text == last) {
+        parser -> text ++;
+        return;
+      } else {
+        parser -> error = 1;
+        return;
+      }
+    }
+  } else if (first == '"') {
+    value -> type = JSON_STRING;
+    if (!(value -> string = parse_string(parser))) parser -> error = 1;
+  } else if (!strncmp(parser -> text, "null", 4))
+    parser -> text += 4;
+  else if (!strncmp(parser -> text, "true", 4) || !strncmp(parser -> text, "false", 5)) {
+    value -> type = JSON_BOOLEAN;
+    value -> number = first == 't';
+    parser -> text += (first == 't') ? 4 : 5;
+  } else {
+    char * end;
+    value -> type = JSON_NUMBER;
+    value -> number = strtod(parser -> text, &end);
+    if (end == parser -> text) parser -> error = 1;
+    parser -> text = end;
+  }
+}
+
+static char * parse_string (struct parser * parser) {
+  // escape sequences are kept as they are, except for escaped quotes and backslashes; only ASCII names are compared
+  if (*parser -> text != '"') return NULL;
+  const char * start = ++ parser -> text;
+  while (*parser -> text && (*parser -> text != '"')) parser -> text += ((*parser -> text == '\\') && parser -> text[1]) ? 2 : 1;
+  if (!*parser -> text) return NULL;
+  char * result = malloc(parser -> text - start + 1), * output = result;
+  if (!result) return NULL;
+  while (start < parser -> text) {
+    if ((*start == '\\') && ((start[1] == '"') || (start[1] == '\\'))) start ++;
+    *(output ++) = *(start ++);
+  }
+  *output = 0;
+  parser -> text ++;
+  return result;
+}
+
+static void skip_spaces (struct parser * parser) {
+  while (*parser -> text && strchr(" \t\r\n", *parser -> text)) parser -> text ++;
+}
+
+static void free_value (struct json_value * value) {
+  unsigned current;
+  for (current = 0; current < value -> count; current ++) {
+    free_value(value -> items + current);
+    if (value -> keys) free(value -> keys[current]);
+  }
+  free(value -> items);
+  free(value -> keys);
+  free(value -> string);
+}
+
+static const struct json_value * member (const struct json_value * object, const char * key) {
+  if (!object || (object -> type != JSON_OBJECT)) return NULL;
+  unsigned current;
+  for (current = 0; current < object -> count; current ++) if (!strcmp(object -> keys[current], key)) return object -> items + current;
+  return NULL;
+}
+
+static unsigned load_cases (const struct json_value * run, struct run_case ** result) {
+  // returns the number of valid cases (those with a name, a median and at least one sample)
+  const struct json_value * cases = member(run, "cases");
+  *result = NULL;
+  if (!cases || (cases -> type != JSON_ARRAY) || !cases -> count) return 0;
+  if (!(*result = calloc(cases -> count, sizeof **result))) return 0;
+  unsigned current, count = 0;
+  for (current = 0; current < cases -> count; current ++) {
+    const struct json_value * name = member(cases -> items + current, "name");
+    const struct json_value * nanoseconds = member(cases -> items + current, "nanoseconds");
+    const struct json_value * median = member(nanoseconds, "median"), * samples = member(nanoseconds, "samples");
+    if (!(name && name -> string && median && (median -> type == JSON_NUMBER) && (median -> number > 0) && samples &&
+          (samples -> type == JSON_ARRAY) && samples -> count && (samples -> count <= BENCHMARK_MAX_REPETITIONS)))
+      continue;
+    // the samples are stored in the comparator's own array, since the parsed values aren't contiguous doubles
+    double * values = malloc(samples -> count * sizeof *values);
+    if (!values) continue;
+    unsigned sample;
+    for (sample = 0; sample < samples -> count; sample ++) values[sample] = samples -> items[sample].number;
+    (*result)[count ++] = (struct run_case) {.name = name -> string, .median = median -> number, .count = samples -> count,
+                                             .samples = values};
+  }
+  return count;
+}
+
+struct ranked {
+  double value;
+  unsigned group;
+};
+
+static double mann_whitney (const double * first, unsigned first_count, const double * second, unsigned second_count) {
+  // two-sided p-value, from the normal approximation with a correction for ties; it is reasonable from about 8 samples
+  // per run, and with very few samples it can't show any difference (which makes the comparison err on the safe side)
+  unsigned total = first_count + second_count, current;
+  struct ranked * values = malloc(total * sizeof *values);
+  if (!values) return 1;
+  for (current = 0; current < first_count; current ++) values[current] = (struct ranked) {first[current], 0};
+  for (current = 0; current < second_count; current ++) values[first_count + current] = (struct ranked) {second[current], 1};
+  qsort(values, total, sizeof *values, &compare_ranked);
+  double rank_sum = 0, ties = 0;
+  for (current = 0; current < total;) {
+    unsigned end = current;
+    while ((end < total) && (values[end].value == values[current].value)) end ++;
+    // tied values get the average of their ranks (which are 1-based)
+    double rank = (current + end + 1) / 2.0, tied = end - current;
+    ties += tied * tied * tied - tied;
+    for (; current < end; current ++) if (!values[current].group) rank_sum += rank;
+  }
+  free(values);
+  double u = rank_sum - first_count * (first_count + 1) / 2.0, mean = first_count * (double) second_count / 2;
+  double variance = first_count * (double) second_count / 12 * ((total + 1) - ties / (total * (double) (total - 1)));
+  if (!(variance > 0)) return 1;
+  double z = (fabs(u - mean) - 0.5) / sqrt(variance);
+  if (z < 0) return 1;
+  return erfc(z / sqrt(2));
+}
+
+static int compare_ranked (const void * first, const void * second) {
+  double first_value = ((const struct ranked *) first) -> value, second_value = ((const struct ranked *) second) -> value;
+  return (first_value > second_value) - (first_value < second_value);
+}
@@ -0,0 +1,150 @@
+// throughput of libsrng compared to other common generators, for the same kinds of output: raw bytes, 16-bit and
+// 64-bit values (built from as many outputs as needed), range-limited values and doubles
+// libsrng is used through its public functions, linked like any other project would
+// build: cc -O2 -c libsrng.c benchmark/harness.c && c++ -O2 -o compare benchmark/compare.cpp libsrng.o harness.o -lm
+
+#include <random>
+
+#include "../libsrng.h"
+
+#include "harness.h"
+#include "reference.h"
+
+#define INITIAL_SEED 0x0123456789abcdefULL
+// bytes generated by each operation of the raw bytes cases
+#define BYTES_PER_FILL 4096
+
+// every generator has the same interface: next returns a value of the given number of (random) bits, bounded returns a
+// value in [0, range) using the method each generator's authors (or library) provide, and unit returns a double in
+// [0, 1) with 53 bits of precision where possible
+struct libsrng_generator {
+  static const unsigned bits = 16;
+  uint64_t state = INITIAL_SEED;
+  uint64_t next () { return libsrng_random(&state, 0, 0); }
+  uint32_t bounded (uint16_t range) { return libsrng_random(&state, range, 0); }
+  double unit () { return libsrng_random_double(&state); }
+};
+
+struct libsrng_buffered_generator {
+  static const unsigned bits = 16;
+  libsrng_buffered_t buffered;
+  libsrng_buffered_generator () { libsrng_buffered_init(&buffered, INITIAL_SEED); }
+  uint64_t next () { return libsrng_buffered_next16(&buffered); }
+  uint32_t bounded (uint16_t range) { return libsrng_buffered_next_range(&buffered, range); }
+  double unit () {
+    uint64_t value = libsrng_buffered_next32(&buffered);
+    value = (value << 32) | libsrng_buffered_next32(&buffered);
+    return (value >> 11) / 9007199254740992.0;
+  }
+};
+
+template <class Engine, unsigned Bits> struct standard_generator {
+  static const unsigned bits = Bits;
+  Engine engine {(typename Engine::result_type) INITIAL_SEED};
+  // minstd_rand generates values in [1, 2^31 - 1), so its top bit is always clear; only the lower 31 bits are used
+  uint64_t next () { return engine() & (((uint64_t) 1 << Bits) - 1); }
+  uint32_t bounded (uint16_t range) { return std::uniform_int_distribution<uint32_t>(0, range - 1)(engine); }
+  double unit () { return std::generate_canonical<double, 53>(engine); }
+};
+
+struct xoshiro256_generator {
+  static const unsigned bits = 64;
+  xoshiro256_state state;
+  xoshiro256_generator () { xoshiro256_seed(&state, INITIAL_SEED); }
+  uint64_t next () { return xoshiro256_next(&state); }
+  uint32_t bounded (uint16_t range) { return xoshiro256_bounded(&state, range); }
+  double unit () { return xoshiro256_double(&state); }
+};
+
+struct pcg32_generator {
+  static const unsigned bits = 32;
+  pcg32_state state;
+  pcg32_generator () { pcg32_seed(&state, INITIAL_SEED, 0); }
+  uint64_t next () { return pcg32_next(&state); }
+  uint32_t bounded (uint16_t range) { return pcg32_bounded(&state, range); }
+  double unit () { return pcg32_double(&state); }
+};
+
+typedef standard_generator<std::mt19937, 32> mt19937_generator;
+typedef standard_generator<std::minstd_rand, 31> minstd_generator;
+
+template <class Generator> static uint64_t run_bytes (const void * parameters, uint64_t count) {
+  // every output contributes its whole bytes (so 31-bit values contribute 3 bytes)
+  (void) parameters;
+  Generator generator;
+  unsigned char buffer[BYTES_PER_FILL];
+  uint64_t result = 0;
+  const unsigned width = Generator::bits / 8;
+  while (count --) {
+    unsigned position;
+    for (position = 0; position < BYTES_PER_FILL; position += width) {
+      uint64_t value = generator.next();
+      unsigned byte;
+      for (byte = 0; (byte < width) && ((position + byte) < BYTES_PER_FILL); byte ++) buffer[position + byte] = value >> (8 * byte);
+    }
+    result += buffer[count % BYTES_PER_FILL];
+  }
+  return result;
+}
+
+template <class Generator> static uint64_t run_16 (const void * parameters, uint64_t count) {
+  (void) parameters;
+  Generator generator;
+  uint64_t result = 0;
+  while (count --) result += generator.next() >> (Generator::bits - 16);
+  return result;
+}
+
+template <class Generator> static uint64_t run_64 (const void * parameters, uint64_t count) {
+  (void) parameters;
+  Generator generator;
+  uint64_t result = 0;
+  while (count --) {
+    uint64_t value = generator.next();
+    unsigned bits;
+    // the mask only avoids a warning for 64-bit generators, which never enter the loop
+    for (bits = Generator::bits; bits < 64; bits += Generator::bits) value = (value << (Generator::bits & 63)) ^ generator.next();
+    result += value;
+  }
+  return result;
+}
+
+template <class Generator> static uint64_t run_bounded (const void * parameters, uint64_t count) {
+  // read through a volatile pointer so that the compiler can't specialize the loop for a constant range
+  uint16_t range = *(const volatile uint16_t *) parameters;
+  Generator generator;
+  uint64_t result = 0;
+  while (count --) result += generator.bounded(range);
+  return result;
+}
+
+template <class Generator> static uint64_t run_double (const void * parameters, uint64_t count) {
+  (void) parameters;
+  Generator generator;
+  double result = 0;
+  while (count --) result += generator.unit();
+  return result;
+}
+
+static const uint16_t range_1000 = 1000, range_0x8001 = 0x8001;
+
+#define GENERATOR_CASES(name, generator)                                        \
+  {name " bytes", &run_bytes<generator>, NULL, BYTES_PER_FILL},                 \
+  {name " 16-bit", &run_16<generator>, NULL, 2},                                \
+  {name " 64-bit", &run_64<generator>, NULL, 8},                                \
+  {name " range 1000", &run_bounded<generator>, &range_1000, 2},                \
+  {name " range 0x8001", &run_bounded<generator>, &range_0x8001, 2},            \
+  {name " double", &run_double<generator>, NULL, 8}
+
+static const benchmark_case cases[] = {
+  GENERATOR_CASES("libsrng", libsrng_generator),
+  GENERATOR_CASES("libsrng buffered", libsrng_buffered_generator),
+  GENERATOR_CASES("mt19937", mt19937_generator),
+  GENERATOR_CASES("minstd_rand", minstd_generator),
+  GENERATOR_CASES("xoshiro256**", xoshiro256_generator),
+  GENERATOR_CASES("pcg32", pcg32_generator)
+};
+
+int main (int argc, char ** argv) {
+  return benchmark_main(argc, argv, cases, sizeof cases / sizeof *cases);
+}
@@ -0,0 +1,482 @@
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+  #include <sched.h>
+  #include <unistd.h>
+  #include <sys/utsname.h>
+  #include <sys/ioctl.h>
+  #include <sys/syscall.h>
+  #include <linux/perf_event.h>
+  #define HAS_COUNTERS 1
+#else
+  #define HAS_COUNTERS 0
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+  #define HAS_CYCLES 1
+#else
+  #define HAS_CYCLES 0
+#endif
+
+#include "harness.h"
+
+// limits for the calibration: no repetition runs more than this many operations, and every case is warmed up for at
+// least this many calibration rounds (each one running the case for roughly the time of a repetition)
+#define MAX_COUNT       ((uint64_t) 1 << 40)
+#define WARMUP_ROUNDS   3
+
+// the flags the benchmarks were compiled with can't be detected, so they can be passed as a string for the JSON output
+#ifndef BENCHMARK_FLAGS
+  #define BENCHMARK_FLAGS ""
+#endif
+
+volatile uint64_t benchmark_sink;
+
+// file descriptors for the hardware counters (the first one leads the group), or -1 if they aren't available
+static int counter_descriptors[BENCHMARK_COUNTERS] = {-1, -1, -1, -1};
+
+static FILE * json_file = NULL;
+static unsigned json_cases;
+
+static int compare_doubles(const void *, const void *);
+static double median_deviation(const double *, unsigned, double);
+static int counters_open(void);
+static void counters_start(void);
+static void counters_stop(double *);
+static void json_string(const char *);
+static void json_number(double);
+static void json_cpu_model(void);
+
+void benchmark_usage (const char * program, const char * extra) {
+  fprintf(stderr, "usage: %s [options]%s\n"
+                  "  --repetitions=N   repetitions of each case (default: 15)\n"
+                  "  --time=MS         minimum time of each repetition, in milliseconds (default: 50)\n"
+                  "  --cpu=N           CPU to run on (default: the current one; -1 to not pin)\n"
+                  "  --filter=TEXT     only run cases whose name contains TEXT\n"
+                  "  --counters        read hardware performance counters (Linux only)\n"
+                  "  --json=FILE       also write the results to FILE as JSON\n", program, extra ? extra : "");
+}
+
+int benchmark_parse_options (struct benchmark_options * options, int argc, char ** argv) {
+  *options = (struct benchmark_options) {.repetitions = 15, .time = 0.05, .cpu = -2, .filter = NULL, .counters = 0,
+                                         .json = NULL};
+  int current, remaining = 1;
+  for (current = 1; current < argc; current ++) {
+    const char * argument = argv[current];
+    char * end;
+    if (!strncmp(argument, "--repetitions=", 14)) {
+      unsigned long value = strtoul(argument + 14, &end, 10);
+      if (*end || !value || (value > BENCHMARK_MAX_REPETITIONS)) return -1;
+      options -> repetitions = value;
+    } else if (!strncmp(argument, "--time=", 7)) {
+      double value = strtod(argument + 7, &end);
+      if (*end || !(value > 0)) return -1;
+      options -> time = value / 1000;
+    } else if (!strncmp(argument, "--cpu=", 6)) {
+      long value = strtol(argument + 6, &end, 10);
+      if (*end || (value < -1) || (value > 65535)) return -1;
+      options -> cpu = value;
+    } else if (!strncmp(argument, "--filter=", 9))
+      options -> filter = argument + 9;
+    else if (!strcmp(argument, "--counters"))
+      options -> counters = 1;
+    else if (!strncmp(argument, "--json=", 7) && argument[7])
+      options -> json = argument + 7;
+    else
+      argv[remaining ++] = argv[current];
+  }
+  argv[remaining] = NULL;
+  return remaining - 1;
+}
+
+int benchmark_pin (const struct benchmark_options * options) {
+#ifdef __linux__
+  int cpu = options -> cpu;
+  if (cpu == -2) cpu = sched_getcpu();
+  if (cpu < 0) return options -> cpu == -1;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return !sched_setaffinity(0, sizeof set, &set);
+#else
+  return options -> cpu < 0;
+#endif
+}
+
+int benchmark_selected (const struct benchmark_options * options, const char * name) {
+  return !options -> filter || strstr(name, options -> filter);
+}
+
+void benchmark_run (const struct benchmark_case * benchmark, const struct benchmark_options * options,
+                    struct benchmark_result * result) {
+  // calibration: grow the count until a run takes the time of a repetition, and keep running at that count for a few
+  // rounds so that caches, branch predictors and the CPU's frequency settle before measuring
+  uint64_t count = 1, start;
+  unsigned rounds = 0;
+  while (rounds < WARMUP_ROUNDS) {
+    start = benchmark_nanoseconds();
+    benchmark_sink += benchmark -> run(benchmark -> parameters, count);
+    double elapsed = (benchmark_nanoseconds() - start) * 1e-9;
+    if ((elapsed >= options -> time) || (count >= MAX_COUNT))
+      rounds ++;
+    else if (elapsed < options -> time / 16)
+      count *= 16;
+    else
+      count = count * (options -> time * 1.1 / elapsed) + 1;
+  }
+  unsigned counter, counters = options -> counters && counters_open();
+  double * nanoseconds = malloc((2 + BENCHMARK_COUNTERS) * options -> repetitions * sizeof *nanoseconds);
+  if (!nanoseconds) {
+    fputs("out of memory\n", stderr);
+    exit(1);
+  }
+  double * cycles = nanoseconds + options -> repetitions;
+  // counter values are stored by counter: all repetitions for the first counter, then for the second, and so on
+  double * counter_values = cycles + options -> repetitions;
+  unsigned repetition;
+  for (repetition = 0; repetition < options -> repetitions; repetition ++) {
+    double values[BENCHMARK_COUNTERS];
+    if (counters) counters_start();
+    uint64_t first_cycle = benchmark_cycles();
+    start = benchmark_nanoseconds();
+    benchmark_sink += benchmark -> run(benchmark -> parameters, count);
+    uint64_t end = benchmark_nanoseconds(), last_cycle = benchmark_cycles();
+    if (counters) counters_stop(values);
+    nanoseconds[repetition] = (double) (end - start) / count;
+    cycles[repetition] = (double) (last_cycle - first_cycle) / count;
+    if (counters) for (counter = 0; counter < BENCHMARK_COUNTERS; counter ++)
+      counter_values[counter * options -> repetitions + repetition] = (values[counter] < 0) ? -1 : values[counter] / count;
+  }
+  result -> count = count;
+  result -> repetitions = options -> repetitions;
+  memcpy(result -> samples, nanoseconds, options -> repetitions * sizeof *nanoseconds);
+  result -> nanoseconds = benchmark_median(nanoseconds, options -> repetitions);
+  result -> nanoseconds_deviation = median_deviation(nanoseconds, options -> repetitions, result -> nanoseconds);
+  if (benchmark_has_cycles()) {
+    result -> cycles = benchmark_median(cycles, options -> repetitions);
+    result -> cycles_deviation = median_deviation(cycles, options -> repetitions, result -> cycles);
+  } else
+    result -> cycles = result -> cycles_deviation = -1;
+  for (counter = 0; counter < BENCHMARK_COUNTERS; counter ++)
+    result -> counters[counter] = counters ? benchmark_median(counter_values + counter * options -> repetitions,
+                                                              options -> repetitions) : -1;
+  free(nanoseconds);
+}
+
+void benchmark_report_header (const struct benchmark_options * options) {
+  printf("%-28s %12s %10s %12s %12s", "case", "ns/op", "(MAD)", "cycles/op", "cycles/byte");
+  // the counters are reported per operation: core cycles, instructions per cycle, branch and L1 data cache misses; the
+  // columns are only shown if the counters can be read, since benchmark_run doesn't read them otherwise
+  if (options -> counters && counters_open()) printf(" %12s %8s %12s %12s", "core cyc/op", "IPC", "br-miss/op", "L1-miss/op");
+  putchar('\n');
+}
+
+void benchmark_report (const struct benchmark_case * benchmark, const struct benchmark_result * result) {
+  printf("%-28s %12.3f %10.3f", benchmark -> name, result -> nanoseconds, result -> nanoseconds_deviation);
+  if (result -> cycles < 0)
+    printf(" %12s %12s", "-", "-");
+  else if (!benchmark -> bytes)
+    printf(" %12.2f %12s", result -> cycles, "-");
+  else
+    printf(" %12.2f %12.3f", result -> cycles, result -> cycles / benchmark -> bytes);
+  const double * counters = result -> counters;
+  if (counters[BENCHMARK_CYCLES] >= 0) {
+    printf(" %12.2f", counters[BENCHMARK_CYCLES]);
+    if ((counters[BENCHMARK_INSTRUCTIONS] >= 0) && (counters[BENCHMARK_CYCLES] > 0))
+      printf(" %8.3f", counters[BENCHMARK_INSTRUCTIONS] / counters[BENCHMARK_CYCLES]);
+    else
+      printf(" %8s", "-");
+    unsigned counter;
+    for (counter = BENCHMARK_BRANCH_MISSES; counter <= BENCHMARK_L1_MISSES; counter ++)
+      if (counters[counter] >= 0)
+        printf(" %12.4f", counters[counter]);
+      else
+        printf(" %12s", "-");
+  }
+  putchar('\n');
+  fflush(stdout);
+}
+
+int benchmark_main (int argc, char ** argv, const struct benchmark_case * cases, unsigned count) {
+  struct benchmark_options options;
+  if (benchmark_parse_options(&options, argc, argv)) {
+    benchmark_usage(*argv, NULL);
+    return 2;
+  }
+  return benchmark_run_all(&options, *argv, cases, count);
+}
+
+int benchmark_run_all (const struct benchmark_options * options, const char * program, const struct benchmark_case * cases,
+                       unsigned count) {
+  if (!benchmark_pin(options)) fputs("warning: could not pin the benchmark to a CPU\n", stderr);
+  if (!benchmark_json_begin(options, program)) {
+    fprintf(stderr, "could not open %s\n", options -> json);
+    return 1;
+  }
+  benchmark_report_header(options);
+  unsigned current;
+  for (current = 0; current < count; current ++) {
+    if (!benchmark_selected(options, cases[current].name)) continue;
+    // the result is large (because of the samples), so it isn't allocated on the stack
+    static struct benchmark_result result;
+    benchmark_run(cases + current, options, &result);
+    benchmark_report(cases + current, &result);
+    benchmark_json_case(cases + current, &result);
+  }
+  benchmark_json_end();
+  return 0;
+}
+
+int benchmark_json_begin (const struct benchmark_options * options, const char * program) {
+  if (!options -> json) return 1;
+  if (!(json_file = fopen(options -> json, "w"))) return 0;
+  json_cases = 0;
+  const char * name = strrchr(program, '/');
+  fputs("{\n  \"program\": ", json_file);
+  json_string(name ? name + 1 : program);
+  // environment: everything that could explain a difference between two runs other than the code itself
+  char date[32] = "";
+  time_t now = time(NULL);
+  strftime(date, sizeof date, "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+  fputs(",\n  \"environment\": {\n    \"date\": ", json_file);
+  json_string(date);
+#ifdef __linux__
+  struct utsname system;
+  if (!uname(&system)) {
+    fputs(",\n    \"system\": ", json_file);
+    json_string(system.sysname);
+    fputs(",\n    \"release\": ", json_file);
+    json_string(system.release);
+    fputs(",\n    \"machine\": ", json_file);
+    json_string(system.machine);
+  }
+  fprintf(json_file, ",\n    \"cpus\": %ld", sysconf(_SC_NPROCESSORS_ONLN));
+#endif
+  fputs(",\n    \"cpu_model\": ", json_file);
+  json_cpu_model();
+  fputs(",\n    \"compiler\": ", json_file);
+#ifdef __VERSION__
+  json_string(__VERSION__);
+#else
+  json_string("unknown");
+#endif
+  fputs(",\n    \"flags\": ", json_file);
+  json_string(BENCHMARK_FLAGS);
+#ifdef __OPTIMIZE__
+  fputs(",\n    \"optimized\": true", json_file);
+#else
+  fputs(",\n    \"optimized\": false", json_file);
+#endif
+  fprintf(json_file, "\n  },\n  \"options\": {\"repetitions\": %u, \"time\": ", options -> repetitions);
+  json_number(options -> time);
+  int cpu = options -> cpu;
+#ifdef __linux__
+  // the default is to run on the current CPU, after pinning the benchmark to it
+  if (cpu == -2) cpu = sched_getcpu();
+#endif
+  fprintf(json_file, ", \"cpu\": %d, \"counters\": %s},\n  \"cases\": [", cpu, options -> counters ? "true" : "false");
+  return 1;
+}
+
+void benchmark_json_case (const struct benchmark_case * benchmark, const struct benchmark_result * result) {
+  if (!json_file) return;
+  static const char * const counter_names[BENCHMARK_COUNTERS] = {
+    [BENCHMARK_CYCLES] = "cycles",
+    [BENCHMARK_INSTRUCTIONS] = "instructions",
+    [BENCHMARK_BRANCH_MISSES] = "branch_misses",
+    [BENCHMARK_L1_MISSES] = "l1_misses"
+  };
+  fputs(json_cases ++ ? ",\n    {\"name\": " : "\n    {\"name\": ", json_file);
+  json_string(benchmark -> name);
+  fprintf(json_file, ", \"operations\": %llu, \"bytes\": %u,\n     \"nanoseconds\": {\"median\": ",
+          (unsigned long long) result -> count, benchmark -> bytes);
+  json_number(result -> nanoseconds);
+  fputs(", \"mad\": ", json_file);
+  json_number(result -> nanoseconds_deviation);
+  fputs(", \"samples\": [", json_file);
+  unsigned current;
+  for (current = 0; current < result -> repetitions; current ++) {
+    if (current) fputs(", ", json_file);
+    json_number(result -> samples[current]);
+  }
+  fputs("]},\n     \"cycles\": ", json_file);
+  if (result -> cycles < 0)
+    fputs("null", json_file);
+  else {
+    fputs("{\"median\": ", json_file);
+    json_number(result -> cycles);
+    fputs(", \"mad\": ", json_file);
+    json_number(result -> cycles_deviation);
+    putc('}', json_file);
+  }
+  fputs(", \"counters\": {", json_file);
+  for (current = 0; current < BENCHMARK_COUNTERS; current ++) {
+    fprintf(json_file, "%s\"%s\": ", current ? ", " : "", counter_names[current]);
+    if (result -> counters[current] < 0)
+      fputs("null", json_file);
+    else
+      json_number(result -> counters[current]);
+  }
+  fputs("}}", json_file);
+  fflush(json_file);
+}
+
+void benchmark_json_end (void) {
+  if (!json_file) return;
+  fputs("\n  ]\n}\n", json_file);
+  fclose(json_file);
+  json_file = NULL;
+}
+
+uint64_t benchmark_nanoseconds (void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+uint64_t benchmark_cycles (void) {
+#if HAS_CYCLES
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+int benchmark_has_cycles (void) {
+  return HAS_CYCLES;
+}
+
+double benchmark_median (double * values, unsigned count) {
+  if (!count) return 0;
+  qsort(values, count, sizeof *values, &compare_doubles);
+  return (count & 1) ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+static int compare_doubles (const void * first, const void * second) {
+  double first_value = *(const double *) first, second_value = *(const double *) second;
+  return (first_value > second_value) - (first_value < second_value);
+}
+
+static double median_deviation (const double * values, unsigned count, double median) {
+  double * deviations = malloc(count * sizeof *deviations);
+  if (!deviations) return NAN;
+  unsigned current;
+  for (current = 0; current < count; current ++) deviations[current] = fabs(values[current] - median);
+  double result = benchmark_median(deviations, count);
+  free(deviations);
+  return result;
+}
+
+static int counters_open (void) {
+  // opens the counters the first time; returns whether the group leader (the cycle counter) is available
+#if HAS_COUNTERS
+  static int opened = 0;
+  if (opened) return counter_descriptors[BENCHMARK_CYCLES] >= 0;
+  opened = 1;
+  const struct {
+    uint32_t type;
+    uint64_t config;
+  } events[BENCHMARK_COUNTERS] = {
+    [BENCHMARK_CYCLES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    [BENCHMARK_INSTRUCTIONS] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    [BENCHMARK_BRANCH_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    [BENCHMARK_L1_MISSES] = {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)}
+  };
+  unsigned counter;
+  for (counter = 0; counter < BENCHMARK_COUNTERS; counter ++) {
+    struct perf_event_attr attributes;
+    memset(&attributes, 0, sizeof attributes);
+    attributes.size = sizeof attributes;
+    attributes.type = events[counter].type;
+    attributes.config = events[counter].config;
+    // only count the benchmark itself, which also works with the default perf_event_paranoid setting
+    attributes.exclude_kernel = attributes.exclude_hv = 1;
+    attributes.disabled = !counter;
+    attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    counter_descriptors[counter] = syscall(SYS_perf_event_open, &attributes, 0, -1, counter_descriptors[BENCHMARK_CYCLES], 0);
+    if (!counter && (counter_descriptors[counter] < 0)) {
+      fputs("warning: hardware performance counters are not available\n", stderr);
+      return 0;
+    }
+  }
+  return 1;
+#else
+  static int warned = 0;
+  if (!warned) fputs("warning: hardware performance counters are not available\n", stderr);
+  warned = 1;
+  return 0;
+#endif
+}
+
+static void counters_start (void) {
+#if HAS_COUNTERS
+  ioctl(counter_descriptors[BENCHMARK_CYCLES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(counter_descriptors[BENCHMARK_CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+static void counters_stop (double * values) {
+  unsigned counter;
+#if HAS_COUNTERS
+  ioctl(counter_descriptors[BENCHMARK_CYCLES], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  for (counter = 0; counter < BENCHMARK_COUNTERS; counter ++) {
+    // value, time enabled, time running: if the counter was multiplexed with others, its value is scaled up
+    uint64_t data[3];
+    if ((counter_descriptors[counter] < 0) || (read(counter_descriptors[counter], data, sizeof data) != sizeof data) || !data[2])
+      values[counter] = -1;
+    else
+      values[counter] = (double) data[0] * data[1] / data[2];
+  }
+#else
+  for (counter = 0; counter < BENCHMARK_COUNTERS; counter ++) values[counter] = -1;
+#endif
+}
+
+static void json_string (const char * text) {
+  putc('"', json_file);
+  for (; *text; text ++)
+    if ((*text == '"') || (*text == '\\'))
+      fprintf(json_file, "\\%c", *text);
+    else if ((unsigned char) *text < 0x20)
+      fprintf(json_file, "\\u%04x", (unsigned) *text);
+    else
+      putc(*text, json_file);
+  putc('"', json_file);
+}
+
+static void json_number (double value) {
+  // JSON has no representation for infinities or NaNs
+  if (isfinite(value))
+    fprintf(json_file, "%.17g", value);
+  else
+    fputs("null", json_file);
+}
+
+static void json_cpu_model (void) {
+#ifdef __linux__
+  FILE * cpuinfo = fopen("/proc/cpuinfo", "r");
+  char line[256];
+  if (cpuinfo) {
+    while (fgets(line, sizeof line, cpuinfo)) {
+      // x86 calls it "model name"; other architectures use other names, but usually one of these
+      if (strncmp(line, "model name", 10) && strncmp(line, "Processor", 9) && strncmp(line, "cpu model", 9)) continue;
+      char * value = strchr(line, ':');
+      if (!value) continue;
+      for (value ++; *value == ' '; value ++);
+      value[strcspn(value, "\n")] = 0;
+      json_string(value);
+      fclose(cpuinfo);
+      return;
+    }
+    fclose(cpuinfo);
+  }
+#endif
+  json_string("unknown");
+}
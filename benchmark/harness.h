@@ -0,0 +1,90 @@
+#ifndef ___LIBSRNG_BENCHMARK
+
+#define ___LIBSRNG_BENCHMARK
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BENCHMARK_MAX_REPETITIONS 1000
+
+// hardware counters read (where available) when the counters option is enabled
+enum benchmark_counter {
+  BENCHMARK_CYCLES,
+  BENCHMARK_INSTRUCTIONS,
+  BENCHMARK_BRANCH_MISSES,
+  BENCHMARK_L1_MISSES,
+  BENCHMARK_COUNTERS
+};
+
+// a benchmark case: run performs count operations and returns a value computed from their results, so that the
+// compiler can't discard them; bytes is the amount of random output of each operation (0 if it doesn't output any)
+struct benchmark_case {
+  const char * name;
+  uint64_t (* run) (const void * parameters, uint64_t count);
+  const void * parameters;
+  unsigned bytes;
+};
+
+struct benchmark_options {
+  unsigned repetitions;
+  double time;           // minimum time for each repetition, in seconds
+  int cpu;               // CPU to run on, or -1 to let the system choose
+  const char * filter;   // only run cases whose name contains this string (null to run all of them)
+  int counters;          // read hardware counters (through perf_event_open) around each repetition
+  const char * json;     // file to write the results to, as JSON (null for none)
+};
+
+// all values are per operation; the deviations are median absolute deviations
+struct benchmark_result {
+  uint64_t count;        // operations in each repetition
+  double nanoseconds;
+  double nanoseconds_deviation;
+  double cycles;         // reference (timestamp counter) cycles; negative if the counter isn't available
+  double cycles_deviation;
+  double counters[BENCHMARK_COUNTERS];  // medians of the hardware counters; negative if they weren't read
+  unsigned repetitions;
+  double samples[BENCHMARK_MAX_REPETITIONS];  // nanoseconds per operation of each repetition, in the order they ran
+};
+
+// parses the common options (see benchmark_usage) into options, starting from the defaults; arguments that aren't
+// common options are left in argv (which is compacted) and their count is returned, or -1 on error
+int benchmark_parse_options(struct benchmark_options * options, int argc, char ** argv);
+void benchmark_usage(const char * program, const char * extra);
+// pins the calling thread to the selected CPU; returns 0 on failure
+int benchmark_pin(const struct benchmark_options * options);
+int benchmark_selected(const struct benchmark_options * options, const char * name);
+// warms up and calibrates the case, then runs the repetitions
+void benchmark_run(const struct benchmark_case * benchmark, const struct benchmark_options * options,
+                   struct benchmark_result * result);
+void benchmark_report_header(const struct benchmark_options * options);
+void benchmark_report(const struct benchmark_case * benchmark, const struct benchmark_result * result);
+// JSON output: benchmark_json_begin opens the file selected by the options (returning 0 on failure; if no file is
+// selected, it does nothing and the other functions are no-ops), and benchmark_json_end completes and closes it
+int benchmark_json_begin(const struct benchmark_options * options, const char * program);
+void benchmark_json_case(const struct benchmark_case * benchmark, const struct benchmark_result * result);
+void benchmark_json_end(void);
+// parses the common options, pins the thread, and runs and reports every selected case
+int benchmark_main(int argc, char ** argv, const struct benchmark_case * cases, unsigned count);
+// same as above, for options that were already parsed (for benchmarks that take their own arguments too); returns the
+// exit status for the program
+int benchmark_run_all(const struct benchmark_options * options, const char * program, const struct benchmark_case * cases,
+                      unsigned count);
+
+// time and timestamp counter readings, for benchmarks that do their own timing
+uint64_t benchmark_nanoseconds(void);
+uint64_t benchmark_cycles(void);
+int benchmark_has_cycles(void);
+// sorts values and returns their median
+double benchmark_median(double * values, unsigned count);
+
+// results of all runs are accumulated here
+extern volatile uint64_t benchmark_sink;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,214 @@
+// per-call latency of range-limited values: every call is timed individually and recorded into a log-linear histogram
+// (like HDR histograms: 2^SUB_BUCKET_BITS linear sub-buckets for each power of two), to show the tail that rejection
+// sampling adds for each limit
+// build: cc -O2 -o latency benchmark/latency.c benchmark/harness.c -lm
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../libsrng.c"
+
+#include "harness.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+  #define TICK_UNIT "cycles"
+#else
+  #define TICK_UNIT "ns"
+#endif
+
+#define SUB_BUCKET_BITS 7
+#define SUB_BUCKETS     (1u << SUB_BUCKET_BITS)
+#define BUCKETS         48
+#define WARMUP_CALLS    10000
+#define MAX_LIMITS      65536
+
+struct histogram {
+  uint64_t total;
+  uint64_t max;
+  uint64_t counts[BUCKETS][SUB_BUCKETS];
+};
+
+static const uint16_t default_limits[] = {2, 3, 10, 100, 256, 1000, 0x5555, 0x7fff, 0x8001, 0xaaab, 0xffff};
+
+static inline uint64_t ticks(void);
+static uint16_t method_range(uint64_t *, uint16_t);
+static uint16_t method_buffered(uint64_t *, uint16_t);
+static uint16_t method_none(uint64_t *, uint16_t);
+static void histogram_record(struct histogram *, uint64_t);
+static uint64_t histogram_percentile(const struct histogram *, double);
+static double expected_resamples(uint16_t);
+static uint64_t count_resamples(uint64_t, uint16_t, uint64_t);
+static unsigned parse_limits(const char *, uint16_t *);
+
+static struct histogram histogram;
+static libsrng_buffered_t buffered;
+// called through a volatile pointer, so that the compiler can't move any part of the call outside the timestamps
+static uint16_t (* volatile method) (uint64_t *, uint16_t);
+
+int main (int argc, char ** argv) {
+  struct benchmark_options options;
+  static uint16_t limits[MAX_LIMITS];
+  unsigned limit_count = sizeof default_limits / sizeof *default_limits, current;
+  memcpy(limits, default_limits, sizeof default_limits);
+  uint16_t (* selected) (uint64_t *, uint16_t) = &method_range;
+  uint64_t calls = 1000000;
+  int remaining = benchmark_parse_options(&options, argc, argv);
+  for (current = 1; (remaining > 0) && (current <= (unsigned) remaining); current ++) {
+    const char * argument = argv[current];
+    char * end;
+    if (!strcmp(argument, "--all")) {
+      for (limit_count = 0; limit_count < 0xffff; limit_count ++) limits[limit_count] = limit_count + 2;
+      limits[limit_count - 1] = 0;
+    } else if (!strncmp(argument, "--limits=", 9)) {
+      if (!(limit_count = parse_limits(argument + 9, limits))) remaining = -1;
+    } else if (!strncmp(argument, "--calls=", 8)) {
+      calls = strtoull(argument + 8, &end, 10);
+      if (*end || !calls) remaining = -1;
+    } else if (!strcmp(argument, "--method=range"))
+      selected = &method_range;
+    else if (!strcmp(argument, "--method=buffered"))
+      selected = &method_buffered;
+    else
+      remaining = -1;
+  }
+  if (remaining < 0) {
+    benchmark_usage(*argv, "\n  --limits=A-B|A,B,...  limits to test (0 means a full 16-bit value)\n"
+                           "  --all             test every limit (equivalent to --limits=2-65535,0)\n"
+                           "  --calls=N         timed calls for each limit (default: 1000000)\n"
+                           "  --method=M        range (libsrng_random) or buffered (libsrng_buffered_next_range)");
+    return 2;
+  }
+  if (options.json) fputs("warning: this benchmark doesn't support JSON output\n", stderr);
+  if (!benchmark_pin(&options)) fputs("warning: could not pin the benchmark to a CPU\n", stderr);
+  // the cost of the timestamps and an empty call is subtracted from every measurement
+  uint64_t overhead = -1, state = 0x0123456789abcdefULL;
+  method = &method_none;
+  for (current = 0; current < WARMUP_CALLS; current ++) {
+    uint64_t start = ticks();
+    benchmark_sink += method(&state, 0);
+    uint64_t elapsed = ticks() - start;
+    if (elapsed < overhead) overhead = elapsed;
+  }
+  method = selected;
+  printf("# latency in %s, minus a measurement overhead of %llu\n", TICK_UNIT, (unsigned long long) overhead);
+  printf("%6s %10s %10s %8s %8s %8s %10s\n", "limit", "expected", "observed", "p50", "p99", "p99.9", "max");
+  for (current = 0; current < limit_count; current ++) {
+    uint16_t limit = limits[current];
+    uint64_t call, initial = libsrng_at_state(0x0123456789abcdefULL, limit);
+    state = initial;
+    libsrng_buffered_init(&buffered, state);
+    for (call = 0; call < WARMUP_CALLS; call ++) benchmark_sink += method(&state, limit);
+    // restart from the initial state so that the resamples counted below are the ones that actually happened
+    state = initial;
+    libsrng_buffered_init(&buffered, state);
+    memset(&histogram, 0, sizeof histogram);
+    for (call = 0; call < calls; call ++) {
+      uint64_t start = ticks();
+      benchmark_sink += method(&state, limit);
+      uint64_t elapsed = ticks() - start;
+      histogram_record(&histogram, (elapsed > overhead) ? elapsed - overhead : 0);
+    }
+    printf("%6u %10.6f %10.6f %8llu %8llu %8llu %10llu\n", (unsigned) limit, expected_resamples(limit),
+           (double) count_resamples(initial, limit, calls) / calls, (unsigned long long) histogram_percentile(&histogram, 0.5),
+           (unsigned long long) histogram_percentile(&histogram, 0.99),
+           (unsigned long long) histogram_percentile(&histogram, 0.999), (unsigned long long) histogram.max);
+    fflush(stdout);
+  }
+  return 0;
+}
+
+static inline uint64_t ticks (void) {
+#if defined(__x86_64__) || defined(__i386__)
+  // the fence keeps the timestamp from being read before the previous instructions complete
+  _mm_lfence();
+  uint64_t result = __rdtsc();
+  _mm_lfence();
+  return result;
+#else
+  return benchmark_nanoseconds();
+#endif
+}
+
+static uint16_t method_range (uint64_t * state, uint16_t limit) {
+  return libsrng_random_range(state, limit);
+}
+
+static uint16_t method_buffered (uint64_t * state, uint16_t limit) {
+  (void) state;
+  return libsrng_buffered_next_range(&buffered, limit);
+}
+
+static uint16_t method_none (uint64_t * state, uint16_t limit) {
+  (void) state;
+  return limit;
+}
+
+static void histogram_record (struct histogram * histogram, uint64_t value) {
+  // bucket 0 holds values below SUB_BUCKETS exactly; bucket n > 0 holds [2^(n + 6), 2^(n + 7)) in steps of 2^n (for
+  // SUB_BUCKET_BITS = 7), so every value is recorded with a relative error under 2^-(SUB_BUCKET_BITS - 1)
+  unsigned bucket = 0;
+  while ((value >> bucket) >= SUB_BUCKETS) bucket ++;
+  if (bucket >= BUCKETS) bucket = BUCKETS - 1;
+  histogram -> counts[bucket][(value >> bucket) & (SUB_BUCKETS - 1)] ++;
+  histogram -> total ++;
+  if (value > histogram -> max) histogram -> max = value;
+}
+
+static uint64_t histogram_percentile (const struct histogram * histogram, double fraction) {
+  // returns the highest value that is equivalent (i.e., recorded in the same sub-bucket) to the percentile's value
+  uint64_t target = fraction * histogram -> total, seen = 0;
+  if (target < 1) target = 1;
+  unsigned bucket, sub_bucket;
+  for (bucket = 0; bucket < BUCKETS; bucket ++)
+    for (sub_bucket = 0; sub_bucket < SUB_BUCKETS; sub_bucket ++) {
+      seen += histogram -> counts[bucket][sub_bucket];
+      if (seen >= target) {
+        uint64_t value = (((uint64_t) sub_bucket + 1) << bucket) - 1;
+        return (value < histogram -> max) ? value : histogram -> max;
+      }
+    }
+  return histogram -> max;
+}
+
+static double expected_resamples (uint16_t limit) {
+  // a value is rejected if it is below 0x10000 % limit (which is always lower than limit), so the number of resamples
+  // follows a geometric distribution
+  if (!(limit & (limit - 1))) return 0;
+  double rejection = (double) (0x10000 % limit) / 0x10000;
+  return rejection / (1 - rejection);
+}
+
+static uint64_t count_resamples (uint64_t state, uint16_t limit, uint64_t calls) {
+  // repeats the calls on the same stream, counting every value that libsrng_random_range would have discarded
+  uint64_t resamples = 0;
+  if (limit == 1) return 0;
+  while (calls --) {
+    uint16_t result = libsrng_random_halfword(&state);
+    REDUCE_RANGE(result, limit, (resamples ++, libsrng_random_halfword(&state)));
+  }
+  return resamples;
+}
+
+static unsigned parse_limits (const char * text, uint16_t * limits) {
+  // comma-separated list of limits or ranges of limits; returns the number of limits, or 0 on error
+  unsigned count = 0;
+  while (*text) {
+    char * end;
+    unsigned long first = strtoul(text, &end, 0), last = first;
+    if ((end == text) || (first > 0xffff)) return 0;
+    if (*end == '-') {
+      text = end + 1;
+      last = strtoul(text, &end, 0);
+      if ((end == text) || (last > 0xffff) || (last < first)) return 0;
+    }
+    if ((last - first + 1) > (MAX_LIMITS - count)) return 0;
+    while (first <= last) limits[count ++] = first ++;
+    if (*end == ',')
+      end ++;
+    else if (*end)
+      return 0;
+    text = end;
+  }
+  return count;
+}
@@ -0,0 +1,98 @@
+#ifndef ___LIBSRNG_BENCHMARK_REFERENCE
+
+#define ___LIBSRNG_BENCHMARK_REFERENCE
+
+// reference implementations of other generators, for comparison purposes only
+// xoshiro256**: David Blackman and Sebastiano Vigna, https://prng.di.unimi.it/xoshiro256starstar.c (public domain),
+// transcribed from the reference code and only renamed to avoid clashes
+// PCG32: the PCG-XSH-RR 64/32 generator described by Melissa O'Neill in "PCG: A Family of Simple Fast Space-Efficient
+// Statistically Good Algorithms for Random Number Generation" (2014), implemented here from that description
+
+#include <stdint.h>
+
+struct xoshiro256_state {
+  uint64_t s[4];
+};
+
+struct pcg32_state {
+  uint64_t state;
+  uint64_t increment;
+};
+
+static inline uint64_t xoshiro256_rotate (uint64_t value, int count) {
+  return (value << count) | (value >> (64 - count));
+}
+
+static inline uint64_t xoshiro256_next (struct xoshiro256_state * state) {
+  uint64_t * s = state -> s;
+  const uint64_t result = xoshiro256_rotate(s[1] * 5, 7) * 9;
+  const uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = xoshiro256_rotate(s[3], 45);
+  return result;
+}
+
+// seeds the state with SplitMix64, as recommended by the authors
+static inline void xoshiro256_seed (struct xoshiro256_state * state, uint64_t seed) {
+  unsigned current;
+  for (current = 0; current < 4; current ++) {
+    uint64_t value = (seed += 0x9e3779b97f4a7c15ULL);
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    state -> s[current] = value ^ (value >> 31);
+  }
+}
+
+// values in [0, bound), using the upper 32 bits of each output with Lemire's multiply-and-reject method
+static inline uint32_t xoshiro256_bounded (struct xoshiro256_state * state, uint32_t bound) {
+  uint64_t product = (xoshiro256_next(state) >> 32) * bound;
+  if ((uint32_t) product < bound) {
+    uint32_t threshold = -bound % bound;
+    while ((uint32_t) product < threshold) product = (xoshiro256_next(state) >> 32) * bound;
+  }
+  return product >> 32;
+}
+
+static inline double xoshiro256_double (struct xoshiro256_state * state) {
+  return (xoshiro256_next(state) >> 11) / 9007199254740992.0;
+}
+
+// the multiplier of the underlying 64-bit LCG; the increment must be odd for the LCG to have a full period
+#define PCG32_MULTIPLIER 6364136223846793005ULL
+
+static inline uint32_t pcg32_rotate (uint32_t value, unsigned count) {
+  return (value >> count) | (value << ((32 - count) & 31));
+}
+
+// the output is computed from the state before the LCG step, so that both can run in parallel: xorshift the high bits
+// down ("XSH") and keep 32 bits, then rotate them by the top 5 bits of the state ("RR")
+static inline uint32_t pcg32_next (struct pcg32_state * state) {
+  uint64_t current = state -> state;
+  state -> state = current * PCG32_MULTIPLIER + state -> increment;
+  return pcg32_rotate((uint32_t) (((current >> 18) ^ current) >> 27), current >> 59);
+}
+
+// the sequence selects one of 2^63 streams (through the increment); the seed is mixed in through one LCG step
+static inline void pcg32_seed (struct pcg32_state * state, uint64_t seed, uint64_t sequence) {
+  state -> increment = (sequence << 1) | 1;
+  state -> state = (seed + state -> increment) * PCG32_MULTIPLIER + state -> increment;
+}
+
+// values in [0, bound) without bias: 2^32 % bound is the number of values at the bottom of the 32-bit range that would
+// make the values below it more likely, so they are discarded
+static inline uint32_t pcg32_bounded (struct pcg32_state * state, uint32_t bound) {
+  uint32_t discarded = (uint32_t) -bound % bound, value;
+  do value = pcg32_next(state); while (value < discarded);
+  return value % bound;
+}
+
+static inline double pcg32_double (struct pcg32_state * state) {
+  uint64_t high = pcg32_next(state) >> 5, low = pcg32_next(state) >> 6;
+  return ((high << 26) | low) / 9007199254740992.0;
+}
+
+#endif
@@ -0,0 +1,182 @@
+// replays a trace of libsrng_random calls (recorded by libsrng.c compiled with LIBSRNG_TRACE=1) through every way of
+// generating the same values, to measure them on a real workload's mix of ranges and reseeds instead of a fixed range
+// every case replays the trace from the beginning, wrapping around as needed, and reports the time for each call
+// build: cc -O2 -o replay benchmark/replay.c benchmark/harness.c libsrng.c -lm
+// usage: replay [options] trace-file
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../libsrng.h"
+
+#include "harness.h"
+
+#define INITIAL_SEED    0x0123456789abcdefULL
+// states stepped together by each call in the pooled case, each one replaying the same trace
+#define POOL_BATCH      16
+#define TRACE_SIGNATURE "LSRNGTR1"
+
+struct trace {
+  size_t length;
+  uint16_t * ranges;
+  uint32_t * reseeds;
+};
+
+static int load_trace(const char *, struct trace *);
+static uint64_t run_random(const void *, uint64_t);
+static uint64_t run_buffered(const void *, uint64_t);
+static uint64_t run_thread_local(const void *, uint64_t);
+static uint64_t run_pooled(const void *, uint64_t);
+
+static struct trace trace;
+
+static const struct benchmark_case cases[] = {
+  {"libsrng_random", &run_random, &trace, 2},
+  {"buffered", &run_buffered, &trace, 2},
+  {"thread-local", &run_thread_local, &trace, 2},
+  {"pooled x16", &run_pooled, &trace, 2}
+};
+
+int main (int argc, char ** argv) {
+  struct benchmark_options options;
+  if (benchmark_parse_options(&options, argc, argv) != 1) {
+    benchmark_usage(*argv, "\n  trace-file        trace recorded with libsrng_trace_start (required)");
+    return 2;
+  }
+  if (!load_trace(argv[1], &trace)) {
+    fprintf(stderr, "could not load the trace from %s\n", argv[1]);
+    return 1;
+  }
+  size_t current, reseeds = 0;
+  for (current = 0; current < trace.length; current ++) if (trace.reseeds[current]) reseeds ++;
+  printf("# %zu calls, %zu of them reseeding\n", trace.length, reseeds);
+  // the single-stream cases must generate the same values; the pooled case steps different states, so it can't be
+  // compared with them
+  uint64_t expected = run_random(&trace, trace.length);
+  if ((run_buffered(&trace, trace.length) != expected) || (run_thread_local(&trace, trace.length) != expected)) {
+    fputs("error: the cases don't generate the same values\n", stderr);
+    return 1;
+  }
+  int status = benchmark_run_all(&options, *argv, cases, sizeof cases / sizeof *cases);
+  free(trace.ranges);
+  free(trace.reseeds);
+  return status;
+}
+
+static int load_trace (const char * filename, struct trace * trace) {
+  // returns 0 on failure (including an empty trace)
+  FILE * file = fopen(filename, "rb");
+  if (!file) return 0;
+  char signature[8];
+  size_t capacity = 0;
+  int byte, result = (fread(signature, 1, 8, file) == 8) && !memcmp(signature, TRACE_SIGNATURE, 8);
+  trace -> length = 0;
+  trace -> ranges = NULL;
+  trace -> reseeds = NULL;
+  while (result && ((byte = getc(file)) != EOF)) {
+    if (trace -> length == capacity) {
+      capacity = capacity ? capacity * 2 : 4096;
+      uint16_t * ranges = realloc(trace -> ranges, capacity * sizeof *ranges);
+      if (ranges) trace -> ranges = ranges;
+      uint32_t * reseeds = realloc(trace -> reseeds, capacity * sizeof *reseeds);
+      if (reseeds) trace -> reseeds = reseeds;
+      if (!(ranges && reseeds)) result = 0;
+    }
+    unsigned char record[6] = {byte};
+    // truncated records make the whole trace invalid
+    if (!result || (fread(record + 1, 1, 2, file) != 2)) {
+      result = 0;
+      break;
+    }
+    uint32_t reseed = record[2];
+    if (reseed == 0xff) {
+      if (fread(record + 2, 1, 4, file) != 4) {
+        result = 0;
+        break;
+      }
+      reseed = record[2] | ((uint32_t) record[3] << 8) | ((uint32_t) record[4] << 16) | ((uint32_t) record[5] << 24);
+    }
+    trace -> ranges[trace -> length] = record[0] | (record[1] << 8);
+    trace -> reseeds[trace -> length ++] = reseed;
+  }
+  if (ferror(file) || !trace -> length) result = 0;
+  fclose(file);
+  if (!result) {
+    free(trace -> ranges);
+    free(trace -> reseeds);
+  }
+  return result;
+}
+
+static uint64_t run_random (const void * parameters, uint64_t count) {
+  const struct trace * trace = parameters;
+  uint64_t state = INITIAL_SEED, result = 0;
+  size_t position = 0;
+  while (count --) {
+    result += libsrng_random(&state, trace -> ranges[position], trace -> reseeds[position]);
+    if (++ position == trace -> length) position = 0;
+  }
+  return result;
+}
+
+static uint64_t run_buffered (const void * parameters, uint64_t count) {
+  // there is no way to reseed a buffered generator, so reseeding calls continue the sequence from its state directly
+  const struct trace * trace = parameters;
+  libsrng_buffered_t buffered;
+  libsrng_buffered_init(&buffered, INITIAL_SEED);
+  uint64_t result = 0;
+  size_t position = 0;
+  while (count --) {
+    if (trace -> reseeds[position]) {
+      uint64_t state = libsrng_buffered_state(&buffered);
+      result += libsrng_random(&state, trace -> ranges[position], trace -> reseeds[position]);
+      libsrng_buffered_init(&buffered, state);
+    } else
+      result += libsrng_buffered_next_range(&buffered, trace -> ranges[position]);
+    if (++ position == trace -> length) position = 0;
+  }
+  return result;
+}
+
+static uint64_t run_thread_local (const void * parameters, uint64_t count) {
+  const struct trace * trace = parameters;
+  uint64_t result = 0;
+  size_t position = 0;
+  *libsrng_tl_state() = INITIAL_SEED;
+  while (count --) {
+    if (trace -> reseeds[position])
+      result += libsrng_random(libsrng_tl_state(), trace -> ranges[position], trace -> reseeds[position]);
+    else
+      result += libsrng_tl_random(trace -> ranges[position]);
+    if (++ position == trace -> length) position = 0;
+  }
+  return result;
+}
+
+static uint64_t run_pooled (const void * parameters, uint64_t count) {
+  // every step of the pool counts as POOL_BATCH calls
+  const struct trace * trace = parameters;
+  uint64_t states[POOL_BATCH], seed = INITIAL_SEED, result = 0;
+  uint16_t values[POOL_BATCH];
+  libsrng_seed_seq(&seed, 1, states, POOL_BATCH);
+  libsrng_pool_t * pool = libsrng_pool_create(states, POOL_BATCH);
+  if (!pool) {
+    fputs("out of memory\n", stderr);
+    exit(1);
+  }
+  size_t position = 0;
+  while (count) {
+    if (trace -> reseeds[position]) {
+      libsrng_pool_export(pool, 0, states, POOL_BATCH);
+      libsrng_seed_many(states, states, POOL_BATCH, trace -> reseeds[position]);
+      libsrng_pool_import(pool, 0, states, POOL_BATCH);
+    }
+    libsrng_pool_step_all(pool, trace -> ranges[position], values);
+    result += values[0];
+    if (++ position == trace -> length) position = 0;
+    count -= (count < POOL_BATCH) ? count : POOL_BATCH;
+  }
+  libsrng_pool_destroy(pool);
+  return result;
+}
@@ -0,0 +1,204 @@
+// multi-threaded throughput for different ways of laying out the states: every thread draws from its own state in a
+// packed array (where neighboring threads' states share cache lines), in an array padded to one state per cache line,
+// or in a shared pool, or from its thread-local state, or every thread reads blocks from a single shared stream
+// build: cc -O2 -pthread -o scaling benchmark/scaling.c benchmark/harness.c libsrng.c -lm
+
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../libsrng.h"
+
+#include "harness.h"
+
+// draws between checks of the stop flag; a multiple of POOL_BATCH
+#define CHUNK         256
+// states stepped together by each call in the pooled layout
+#define POOL_BATCH    16
+#define CACHE_LINE    64
+#define PADDED_STRIDE (CACHE_LINE / sizeof(uint64_t))
+#define MAX_THREADS   1024
+// states seeded for each thread: enough for a batch of the pooled layout or a cache line of the padded one
+#define THREAD_STATES ((POOL_BATCH > PADDED_STRIDE) ? POOL_BATCH : PADDED_STRIDE)
+
+enum layout {
+  LAYOUT_PACKED,
+  LAYOUT_PADDED,
+  LAYOUT_POOLED,
+  LAYOUT_THREAD_LOCAL,
+  LAYOUT_SHARED,
+  LAYOUTS
+};
+
+struct worker {
+  pthread_t thread;
+  unsigned index;
+  uint64_t operations;
+};
+
+static const char * const layout_names[LAYOUTS] = {
+  [LAYOUT_PACKED] = "packed",
+  [LAYOUT_PADDED] = "padded",
+  [LAYOUT_POOLED] = "pooled",
+  [LAYOUT_THREAD_LOCAL] = "thread-local",
+  [LAYOUT_SHARED] = "shared"
+};
+
+static void * run_worker(void *);
+static double run_layout(enum layout, unsigned);
+static void sleep_seconds(double);
+
+static struct benchmark_options options;
+static enum layout current_layout;
+static uint64_t * states;
+static libsrng_pool_t * pool;
+static libsrng_shared_t * shared;
+static pthread_barrier_t barrier;
+static atomic_int stop;
+static struct worker workers[MAX_THREADS];
+
+int main (int argc, char ** argv) {
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned max_threads = (online > 0) ? online : 1, current;
+  int remaining = benchmark_parse_options(&options, argc, argv);
+  for (current = 1; (remaining > 0) && (current <= (unsigned) remaining); current ++) {
+    char * end;
+    if (!strncmp(argv[current], "--threads=", 10)) {
+      unsigned long value = strtoul(argv[current] + 10, &end, 10);
+      if (*end || !value || (value > MAX_THREADS)) remaining = -1;
+      max_threads = value;
+    } else
+      remaining = -1;
+  }
+  if (remaining < 0) {
+    benchmark_usage(*argv, "\n  --threads=N       largest number of threads (default: one per online CPU)\n"
+                           "  (--filter selects layouts: packed, padded, pooled, thread-local, shared)");
+    return 2;
+  }
+  if (options.json) fputs("warning: this benchmark doesn't support JSON output\n", stderr);
+  states = aligned_alloc(CACHE_LINE, MAX_THREADS * THREAD_STATES * sizeof *states);
+  if (!states) return 1;
+  // thread counts: powers of two, then the largest count
+  unsigned thread_counts[32], count = 0, threads;
+  for (threads = 1; threads < max_threads; threads *= 2) thread_counts[count ++] = threads;
+  thread_counts[count ++] = max_threads;
+  printf("%-14s %8s %14s %12s %14s %11s\n", "layout", "threads", "Mops/s", "(MAD)", "Mops/s/thread", "efficiency");
+  enum layout layout;
+  for (layout = 0; layout < LAYOUTS; layout ++) {
+    if (!benchmark_selected(&options, layout_names[layout])) continue;
+    double single = 0;
+    for (current = 0; current < count; current ++) {
+      threads = thread_counts[current];
+      double * results = malloc(options.repetitions * sizeof *results);
+      if (!results) return 1;
+      unsigned repetition;
+      // the first run warms up the threads and the states, and isn't counted
+      run_layout(layout, threads);
+      for (repetition = 0; repetition < options.repetitions; repetition ++) results[repetition] = run_layout(layout, threads);
+      double median = benchmark_median(results, options.repetitions);
+      for (repetition = 0; repetition < options.repetitions; repetition ++) results[repetition] = fabs(results[repetition] - median);
+      double deviation = benchmark_median(results, options.repetitions);
+      free(results);
+      if (threads == 1) single = median;
+      // scaling efficiency: throughput relative to that many single-threaded runs
+      printf("%-14s %8u %14.2f %12.2f %14.2f %10.1f%%\n", layout_names[layout], threads, median, deviation,
+             median / threads, single ? 100 * median / (single * threads) : 0);
+      fflush(stdout);
+    }
+  }
+  free(states);
+  return 0;
+}
+
+static double run_layout (enum layout layout, unsigned threads) {
+  // returns the aggregate throughput, in millions of operations per second
+  unsigned current;
+  current_layout = layout;
+  atomic_store(&stop, 0);
+  uint64_t seeds[] = {0x0123456789abcdefULL, threads};
+  libsrng_seed_seq(seeds, 2, states, threads * THREAD_STATES);
+  if (layout == LAYOUT_POOLED) pool = libsrng_pool_create(states, threads * POOL_BATCH);
+  if (layout == LAYOUT_SHARED) shared = libsrng_shared_create(*seeds);
+  if (((layout == LAYOUT_POOLED) && !pool) || ((layout == LAYOUT_SHARED) && !shared)) {
+    fputs("out of memory\n", stderr);
+    exit(1);
+  }
+  pthread_barrier_init(&barrier, NULL, threads + 1);
+  for (current = 0; current < threads; current ++) {
+    workers[current].index = current;
+    workers[current].operations = 0;
+    if (pthread_create(&workers[current].thread, NULL, &run_worker, workers + current)) {
+      fputs("could not create threads\n", stderr);
+      exit(1);
+    }
+  }
+  pthread_barrier_wait(&barrier);
+  uint64_t start = benchmark_nanoseconds();
+  sleep_seconds(options.time);
+  atomic_store(&stop, 1);
+  uint64_t operations = 0;
+  for (current = 0; current < threads; current ++) {
+    pthread_join(workers[current].thread, NULL);
+    operations += workers[current].operations;
+  }
+  uint64_t elapsed = benchmark_nanoseconds() - start;
+  pthread_barrier_destroy(&barrier);
+  libsrng_pool_destroy(pool);
+  libsrng_shared_destroy(shared);
+  pool = NULL;
+  shared = NULL;
+  return (double) operations * 1000 / elapsed;
+}
+
+static void * run_worker (void * argument) {
+  struct worker * worker = argument;
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  struct benchmark_options worker_options = options;
+  // spread the threads over the CPUs; without pinning, the scheduler could stack them
+  worker_options.cpu = worker -> index % ((online > 0) ? online : 1);
+  benchmark_pin(&worker_options);
+  uint64_t * state = states + worker -> index * ((current_layout == LAYOUT_PADDED) ? PADDED_STRIDE : 1);
+  size_t indexes[POOL_BATCH];
+  uint16_t values[POOL_BATCH];
+  unsigned current;
+  for (current = 0; current < POOL_BATCH; current ++) indexes[current] = worker -> index * POOL_BATCH + current;
+  libsrng_shared_reader_t reader;
+  libsrng_shared_reader_init(&reader, shared);
+  uint64_t operations = 0, result = 0;
+  pthread_barrier_wait(&barrier);
+  while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+    switch (current_layout) {
+      case LAYOUT_PACKED:
+      case LAYOUT_PADDED:
+        for (current = 0; current < CHUNK; current ++) result += libsrng_random(state, 0, 0);
+        break;
+      case LAYOUT_POOLED:
+        for (current = 0; current < CHUNK; current += POOL_BATCH) {
+          libsrng_pool_step(pool, indexes, POOL_BATCH, 0, values);
+          result += values[0];
+        }
+        break;
+      case LAYOUT_THREAD_LOCAL:
+        for (current = 0; current < CHUNK; current ++) result += libsrng_tl_random(0);
+        break;
+      default:
+        for (current = 0; current < CHUNK; current ++) result += libsrng_shared_random(&reader, 0);
+    }
+    operations += CHUNK;
+  }
+  worker -> operations = operations;
+  benchmark_sink += result;
+  return NULL;
+}
+
+static void sleep_seconds (double seconds) {
+  struct timespec duration = {.tv_sec = seconds, .tv_nsec = (seconds - (time_t) seconds) * 1e9};
+  while (nanosleep(&duration, &duration));
+}
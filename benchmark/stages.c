@@ -0,0 +1,97 @@
+// benchmarks for each stage of the generator, from the byte generator up to the public functions
+// the internal stages are static functions, so this file includes libsrng.c directly instead of linking against it
+// build: cc -O2 -o stages benchmark/stages.c benchmark/harness.c -lm
+
+#include "../libsrng.c"
+
+#include "harness.h"
+
+#define INITIAL_STATE 0x0123456789abcdefULL
+
+struct stage_parameters {
+  uint16_t range;
+  unsigned reseed;
+};
+
+static uint64_t run_byte(const void *, uint64_t);
+static uint64_t run_halfword(const void *, uint64_t);
+static uint64_t run_range(const void *, uint64_t);
+static uint64_t run_public(const void *, uint64_t);
+static uint64_t run_reseed(const void *, uint64_t);
+static uint64_t run_double(const void *, uint64_t);
+
+// representative limits: powers of two (no rejection), small and large ranges, and the worst case for rejection
+// (0x8001, which rejects almost half of all values)
+static const struct stage_parameters range_2 = {.range = 2}, range_10 = {.range = 10}, range_256 = {.range = 256},
+                                     range_1000 = {.range = 1000}, range_0x5555 = {.range = 0x5555},
+                                     range_0x8001 = {.range = 0x8001}, range_0xffff = {.range = 0xffff};
+static const struct stage_parameters reseed_1 = {.range = 1, .reseed = 1}, reseed_10 = {.range = 1, .reseed = 10},
+                                     reseed_1000 = {.range = 1, .reseed = 1000};
+static const struct stage_parameters public_full = {.range = 0}, public_1000 = {.range = 1000};
+
+static const struct benchmark_case cases[] = {
+  {"byte generator", &run_byte, NULL, 1},
+  {"halfword", &run_halfword, NULL, 2},
+  {"range 2", &run_range, &range_2, 2},
+  {"range 10", &run_range, &range_10, 2},
+  {"range 256", &run_range, &range_256, 2},
+  {"range 1000", &run_range, &range_1000, 2},
+  {"range 0x5555", &run_range, &range_0x5555, 2},
+  {"range 0x8001", &run_range, &range_0x8001, 2},
+  {"range 0xffff", &run_range, &range_0xffff, 2},
+  {"reseed 1", &run_reseed, &reseed_1, 0},
+  {"reseed 10", &run_reseed, &reseed_10, 0},
+  {"reseed 1000", &run_reseed, &reseed_1000, 0},
+  {"double", &run_double, NULL, 8},
+  {"libsrng_random full", &run_public, &public_full, 2},
+  {"libsrng_random 1000", &run_public, &public_1000, 2}
+};
+
+int main (int argc, char ** argv) {
+  return benchmark_main(argc, argv, cases, sizeof cases / sizeof *cases);
+}
+
+static uint64_t run_byte (const void * parameters, uint64_t count) {
+  (void) parameters;
+  uint64_t state = INITIAL_STATE, result = 0;
+  while (count --) result += libsrng_random_combined(&state);
+  return result;
+}
+
+static uint64_t run_halfword (const void * parameters, uint64_t count) {
+  (void) parameters;
+  uint64_t state = INITIAL_STATE, result = 0;
+  while (count --) result += libsrng_random_halfword(&state);
+  return result;
+}
+
+static uint64_t run_range (const void * parameters, uint64_t count) {
+  // the range is read through a volatile pointer so that the compiler can't specialize the loop for it
+  uint16_t range = *(const volatile uint16_t *) &((const struct stage_parameters *) parameters) -> range;
+  uint64_t state = INITIAL_STATE, result = 0;
+  while (count --) result += libsrng_random_range(&state, range);
+  return result;
+}
+
+static uint64_t run_public (const void * parameters, uint64_t count) {
+  uint16_t range = *(const volatile uint16_t *) &((const struct stage_parameters *) parameters) -> range;
+  uint64_t state = INITIAL_STATE, result = 0;
+  while (count --) result += libsrng_random(&state, range, 0);
+  return result;
+}
+
+static uint64_t run_reseed (const void * parameters, uint64_t count) {
+  unsigned reseed = *(const volatile unsigned *) &((const struct stage_parameters *) parameters) -> reseed;
+  uint64_t state = INITIAL_STATE;
+  // range 1: only reseed, without generating a value
+  while (count --) libsrng_random(&state, 1, reseed);
+  return state;
+}
+
+static uint64_t run_double (const void * parameters, uint64_t count) {
+  (void) parameters;
+  uint64_t state = INITIAL_STATE;
+  double result = 0;
+  while (count --) result += libsrng_random_unit(&state);
+  return result;
+}
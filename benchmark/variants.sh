@@ -0,0 +1,115 @@
+#!/bin/sh
+# builds the library in three variants and compares them on the benchmarks that link it like any other project would:
+#   plain: compiled with CFLAGS only, as when libsrng.c is dropped into a project's build
+#   lto:   with link-time optimization, so that calls to the library can be inlined into their callers
+#   pgo:   with link-time and profile-guided optimization, trained on the benchmarks' workloads
+# each variant is built as a static and a shared library (in $BUILD/<variant>), and the benchmarks are linked with the
+# static one; the report compares lto and pgo to plain, using benchmark/comparator.c
+# usage (from the root of the repository): benchmark/variants.sh [trace-file]
+# a trace recorded with libsrng_trace_start, if given, is replayed both for training and in the report
+# environment: CC, CXX, CFLAGS (default: -O2), BUILD (default: variants), BENCHMARK_OPTIONS (passed to every benchmark
+# run in the report); GCC and Clang are supported
+
+set -e
+
+CC=${CC:-cc}
+CXX=${CXX:-c++}
+CFLAGS=${CFLAGS:--O2}
+BUILD=${BUILD:-variants}
+TRACE=
+
+if [ -n "$1" ]; then
+  if [ ! -f "$1" ]; then
+    echo "$0: $1 not found" >&2
+    exit 2
+  fi
+  # the training runs in another directory
+  TRACE=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+fi
+
+# the archiver must understand LTO objects, and each compiler has its own profile format
+CLANG=
+if $CC --version 2>/dev/null | grep -q clang; then
+  CLANG=1
+  AR=${AR:-llvm-ar}
+  PROFILE_GENERATE=-fprofile-instr-generate
+  PROFILE_USE="-fprofile-instr-use=$BUILD/pgo/libsrng.profdata"
+else
+  AR=${AR:-gcc-ar}
+  PROFILE_GENERATE=-fprofile-generate
+  # a profile can't cover every function of the benchmarks (e.g., error paths), which is fine
+  PROFILE_USE="-fprofile-use -Wno-missing-profile"
+fi
+
+# build_library <variant> <flags>: static and shared libraries, from the same flags
+build_library () {
+  mkdir -p "$BUILD/$1"
+  rm -f "$BUILD/$1/libsrng.a"
+  $CC $2 -c -o "$BUILD/$1/libsrng.o" libsrng.c
+  $CC $2 -fPIC -c -o "$BUILD/$1/libsrng.pic.o" libsrng.c
+  $AR rcs "$BUILD/$1/libsrng.a" "$BUILD/$1/libsrng.o"
+  $CC $2 -shared -o "$BUILD/$1/libsrng.so" "$BUILD/$1/libsrng.pic.o" -lm
+}
+
+# build_benchmarks <variant> <flags> [library] [suffix]: the benchmarks, linked with the variant's static library (or
+# the given one), named with the given suffix; the harness is built with the same flags, which it records in the JSON
+# output of every run
+build_benchmarks () {
+  library=${3:-$BUILD/$1/libsrng.a}
+  $CC $2 "-DBENCHMARK_FLAGS=\"$2\"" -c -o "$BUILD/$1/harness$4.o" benchmark/harness.c
+  $CXX $2 -o "$BUILD/$1/compare$4" benchmark/compare.cpp "$library" "$BUILD/$1/harness$4.o" -lm
+  $CC $2 -o "$BUILD/$1/replay$4" benchmark/replay.c "$library" "$BUILD/$1/harness$4.o" -lm
+}
+
+# run_benchmarks <variant>: runs the libsrng cases of the benchmarks (and the trace, if any), saving them as JSON
+run_benchmarks () {
+  "$BUILD/$1/compare" --filter=libsrng $BENCHMARK_OPTIONS --json="$BUILD/$1/compare.json"
+  if [ -n "$TRACE" ]; then "$BUILD/$1/replay" $BENCHMARK_OPTIONS --json="$BUILD/$1/replay.json" "$TRACE"; fi
+}
+
+mkdir -p "$BUILD"
+$CC -O2 -o "$BUILD/comparator" benchmark/comparator.c -lm
+
+echo "# building plain and lto"
+build_library plain "$CFLAGS"
+build_benchmarks plain "$CFLAGS"
+build_library lto "$CFLAGS -flto"
+build_benchmarks lto "$CFLAGS -flto"
+
+echo "# training pgo"
+rm -rf "$BUILD/pgo"
+build_library pgo "$CFLAGS -flto $PROFILE_GENERATE"
+build_benchmarks pgo "$CFLAGS -flto $PROFILE_GENERATE"
+# position-independent code has a different control flow, so the shared library needs its own training
+build_benchmarks pgo "$CFLAGS -flto $PROFILE_GENERATE" "$(cd "$BUILD/pgo" && pwd)/libsrng.so" -shared
+# the training only needs to exercise the code, not to measure it precisely
+(
+  cd "$BUILD/pgo"
+  LLVM_PROFILE_FILE=training-%p.profraw
+  export LLVM_PROFILE_FILE
+  for suffix in "" -shared; do
+    ./compare$suffix --filter=libsrng --repetitions=3 --time=20 > /dev/null
+    if [ -n "$TRACE" ]; then ./replay$suffix --repetitions=3 --time=20 "$TRACE" > /dev/null; fi
+  done
+  rm -f compare-shared replay-shared harness-shared.o
+)
+if [ -n "$CLANG" ]; then
+  llvm-profdata merge -o "$BUILD/pgo/libsrng.profdata" "$BUILD"/pgo/training-*.profraw
+fi
+build_library pgo "$CFLAGS -flto $PROFILE_USE"
+build_benchmarks pgo "$CFLAGS -flto $PROFILE_USE"
+
+for variant in plain lto pgo; do
+  echo "# running $variant"
+  run_benchmarks $variant
+done
+
+# the comparator exits with a status of 1 when a variant is slower, which is a result here rather than an error
+for variant in lto pgo; do
+  for benchmark in compare replay; do
+    if [ -f "$BUILD/plain/$benchmark.json" ]; then
+      echo "# $variant compared to plain ($benchmark)"
+      "$BUILD/comparator" "$BUILD/plain/$benchmark.json" "$BUILD/$variant/$benchmark.json" || [ $? -eq 1 ]
+    fi
+  done
+done
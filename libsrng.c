@@ -1,3 +1,12 @@
+// clock_gettime (for timing consumer stalls with a monotonic clock) is POSIX, so it must be requested before any header
+// is included
+#if !defined(_POSIX_C_SOURCE) && !defined(_GNU_SOURCE)
+  #define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <math.h>
+#include <stdlib.h>
+
 #include "libsrng.h"
 
 struct libsrng_stable_random_state {
@@ -8,11 +17,270 @@ struct libsrng_stable_random_state {
   uint8_t linear;
 };
 
+#define LANE_COUNT 16
+
+// the lane kernels are only faster than the scalar code when the target has vector instructions for 32-bit multiplies
+// and per-lane shifts; define LIBSRNG_LANES to 0 or 1 to override this detection
+#ifndef LIBSRNG_LANES
+  #if defined(__AVX2__) || defined(__ARM_NEON) || defined(__ARM_FEATURE_SVE)
+    #define LIBSRNG_LANES 1
+  #else
+    #define LIBSRNG_LANES 0
+  #endif
+#endif
+
+// thread-local generators need C11 threads and atomics; define LIBSRNG_THREADS to 0 or 1 to override this detection
+#ifndef LIBSRNG_THREADS
+  #if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_THREADS__) && \
+      !defined(__STDC_NO_ATOMICS__)
+    #define LIBSRNG_THREADS 1
+  #else
+    #define LIBSRNG_THREADS 0
+  #endif
+#endif
+
+#if LIBSRNG_THREADS
+  #include <stdatomic.h>
+  #include <threads.h>
+  #include <time.h>
+  // consumer stalls are timed with a monotonic clock, since the wall clock can be stepped or slewed while they wait;
+  // timespec_get with TIME_UTC is only a last resort
+  #if defined(TIME_MONOTONIC)
+    #define STALL_CLOCK(time) timespec_get((time), TIME_MONOTONIC)
+  #elif defined(CLOCK_MONOTONIC)
+    #define STALL_CLOCK(time) clock_gettime(CLOCK_MONOTONIC, (time))
+  #else
+    #define STALL_CLOCK(time) timespec_get((time), TIME_UTC)
+  #endif
+#endif
+
+// halfwords per page handed from a producer thread to a consumer
+#define PRODUCER_PAGE_SIZE 1024
+// rounds without any page to fill that a producer thread spins through (yielding the CPU) before it goes to sleep
+#define PRODUCER_SPINS 64
+
+// per-CPU generators need the CPU number that Linux publishes through rseq, which glibc 2.35 and later registers for
+// every thread; define LIBSRNG_RSEQ to 0 or 1 to override this detection (without it, they use thread-local states)
+#ifndef LIBSRNG_RSEQ
+  #define LIBSRNG_RSEQ 0
+  #if LIBSRNG_THREADS && defined(__linux__) && defined(__has_include) && defined(__has_builtin)
+    #if __has_include(<sys/rseq.h>) && __has_builtin(__builtin_thread_pointer)
+      #undef LIBSRNG_RSEQ
+      #define LIBSRNG_RSEQ 1
+    #endif
+  #endif
+#endif
+
+#if LIBSRNG_RSEQ
+  #include <sys/rseq.h>
+  // CPUs numbered LIBSRNG_CPU_COUNT or higher use thread-local states
+  #ifndef LIBSRNG_CPU_COUNT
+    #define LIBSRNG_CPU_COUNT 256
+  #endif
+  // states are committed through a restartable sequence where one is implemented (it needs an assembly block for each
+  // architecture), and through a compare-and-swap elsewhere
+  #if defined(__x86_64__) && defined(__GNUC__)
+    #define CPU_COMMIT_RSEQ 1
+  #else
+    #define CPU_COMMIT_RSEQ 0
+  #endif
+#endif
+
+// recording of libsrng_random calls into trace files; define LIBSRNG_TRACE to 1 to enable it (it is disabled by default,
+// since every call checks whether a trace is being recorded)
+#ifndef LIBSRNG_TRACE
+  #define LIBSRNG_TRACE 0
+#endif
+
+#if LIBSRNG_TRACE
+  #include <stdio.h>
+#endif
+
+// counters of internal events, read with libsrng_stats; define LIBSRNG_STATS to 1 to enable them (they are disabled by
+// default, and compiled out entirely when disabled)
+#ifndef LIBSRNG_STATS
+  #define LIBSRNG_STATS 0
+#endif
+
+// USDT (SystemTap/DTrace-style static tracepoint) probes, for tools like bpftrace or perf; define LIBSRNG_USDT to 1 to
+// enable them (this needs <sys/sdt.h>, from SystemTap's development files); an unattached probe is a single nop
+// probes, in the "libsrng" provider: random_entry (state, range, reseed) and random_return (state, result) around
+// libsrng_random, reseed (state before reseeding) for every reseeding iteration, and rejection (value, limit) for every
+// value discarded by rejection sampling
+#ifndef LIBSRNG_USDT
+  #define LIBSRNG_USDT 0
+#endif
+
+#if LIBSRNG_USDT
+  #include <sys/sdt.h>
+  #define PROBE1(name, first) STAP_PROBE1(libsrng, name, first)
+  #define PROBE2(name, first, second) STAP_PROBE2(libsrng, name, first, second)
+  #define PROBE3(name, first, second, third) STAP_PROBE3(libsrng, name, first, second, third)
+#else
+  #define PROBE1(name, first) ((void) 0)
+  #define PROBE2(name, first, second) ((void) 0)
+  #define PROBE3(name, first, second, third) ((void) 0)
+#endif
+
 union libsrng_stable_random_state_union {
   uint64_t numeric;
   struct libsrng_stable_random_state structured;
 };
 
+// many states split by field, processed in lockstep by the branch-free (vectorizable) versions of the generator
+// the byte fields are widened to 32 bits so that all operations in the loops have the same width
+struct libsrng_lanes {
+  uint32_t shift[LANE_COUNT];
+  uint32_t carry[LANE_COUNT];
+  uint32_t current[LANE_COUNT];
+  uint32_t prev[LANE_COUNT];
+  uint32_t linear[LANE_COUNT];
+};
+
+struct libsrng_pool {
+  size_t count;
+  // each array is aligned to POOL_ALIGNMENT bytes; all of them point into the same allocation as the structure
+  uint32_t * shift;
+  uint8_t * carry;
+  uint8_t * current;
+  uint8_t * prev;
+  uint8_t * linear;
+};
+
+// the layout of this structure is the file format of the cache, so that caches can be stored in memory-mapped files
+struct libsrng_reseed_cache {
+  uint64_t signature;
+  uint64_t root;
+  uint32_t interval;
+  uint32_t count;
+  uint64_t checkpoints[];
+};
+
+#if LIBSRNG_THREADS
+struct libsrng_shared {
+  uint64_t seed;
+  // keep the counter, which is written by every thread, away from the seed, which is only read
+  _Alignas(64) _Atomic uint64_t next_block;
+};
+
+// a single-producer, single-consumer queue of two pages: the producer fills the page at index tail % 2 while the
+// consumer reads the one at index head % 2; each side only writes its own index, which is on its own cache line
+struct libsrng_consumer {
+  // written by the consumer only
+  _Alignas(64) _Atomic uint64_t head;
+  const uint16_t * page;
+  unsigned position;
+  libsrng_producer_t * producer;
+  _Atomic uint64_t pages;
+  _Atomic uint64_t stalls;
+  _Atomic uint64_t stall_time;
+  // written by the producer only
+  _Alignas(64) _Atomic uint64_t tail;
+  uint64_t state;
+  _Alignas(64) uint16_t buffers[2][PRODUCER_PAGE_SIZE];
+};
+
+struct libsrng_producer {
+  thrd_t thread;
+  _Atomic int stop;
+  // set while the thread waits on wake (with lock held when it changes), so that consumers only signal it then
+  _Atomic int sleeping;
+  mtx_t lock;
+  cnd_t wake;
+  size_t count;
+  struct libsrng_consumer * consumers;
+};
+#endif
+
+struct libsrng_piecewise {
+  unsigned bins;
+  int linear;
+  // all pointers point into data; the guide table is stored after the doubles
+  const double * edges;
+  const double * densities;
+  const double * cdf;
+  const unsigned * guide;
+  double data[];
+};
+
+#if LIBSRNG_TRACE
+static FILE * libsrng_trace_file = NULL;
+#endif
+
+#if LIBSRNG_STATS
+enum libsrng_stats_counter {
+  STATS_REJECTIONS,
+  STATS_SWITCHES,
+  STATS_SHORT_CYCLES,
+  STATS_RESEEDS,
+  STATS_COUNTERS
+};
+
+#if LIBSRNG_THREADS
+// every thread counts into its own block, allocated the first time it counts an event; blocks are never freed, but
+// the block of a thread that exits is handed over to the next thread that needs one, so that its counts aren't lost
+struct libsrng_stats_block {
+  // only written by the thread that owns the block, but read by any thread that calls libsrng_stats
+  _Atomic uint64_t counters[STATS_COUNTERS];
+  _Atomic int owned;
+  struct libsrng_stats_block * next;
+};
+
+static _Thread_local struct libsrng_stats_block * libsrng_stats_local;
+static _Atomic(struct libsrng_stats_block *) libsrng_stats_blocks;
+static once_flag libsrng_stats_once = ONCE_FLAG_INIT;
+static tss_t libsrng_stats_key;
+static int libsrng_stats_key_created;
+#else
+static uint64_t libsrng_stats_counters[STATS_COUNTERS];
+#endif
+
+  #define STATS_COUNT(counter, amount) libsrng_stats_count((counter), (amount))
+#else
+  #define STATS_COUNT(counter, amount) ((void) 0)
+#endif
+
+#if LIBSRNG_THREADS
+// a thread's state is zero until it's first used: initialized states never have a zero shift register, and stepping
+// a state never makes its shift register zero
+static _Thread_local uint64_t libsrng_thread_state;
+static _Atomic uint64_t libsrng_process_seed;
+static _Atomic uint64_t libsrng_thread_count;
+
+#if LIBSRNG_RSEQ
+// each state takes a whole cache line, so that CPUs never write to each other's lines
+struct libsrng_cpu_slot {
+  _Alignas(64) _Atomic uint64_t state;
+};
+
+static struct libsrng_cpu_slot libsrng_cpu_slots[LIBSRNG_CPU_COUNT];
+#endif
+
+static uint64_t libsrng_tl_initial_state(void);
+#if LIBSRNG_RSEQ
+static struct libsrng_cpu_slot * libsrng_cpu_slot(void);
+static uint64_t libsrng_cpu_initial_state(const struct libsrng_cpu_slot *);
+static inline int libsrng_cpu_commit(struct libsrng_cpu_slot *, uint64_t, uint64_t);
+#endif
+static void libsrng_shared_fill(libsrng_shared_reader_t *);
+static inline uint16_t libsrng_consumer_halfword(libsrng_consumer_t *);
+static void libsrng_consumer_next_page(libsrng_consumer_t *);
+static int libsrng_producer_run(void *);
+static int libsrng_producer_pending(libsrng_producer_t *);
+static void libsrng_producer_wake(libsrng_producer_t *);
+#endif
+
+#if LIBSRNG_TRACE
+static void libsrng_trace_record(uint16_t, unsigned);
+#endif
+#if LIBSRNG_STATS && LIBSRNG_THREADS
+static struct libsrng_stats_block * libsrng_stats_claim(void);
+static void libsrng_stats_init(void);
+static void libsrng_stats_release(void *);
+#endif
+#if LIBSRNG_STATS
+static inline void libsrng_stats_count(enum libsrng_stats_counter, uint64_t);
+#endif
 static inline uint16_t libsrng_random_linear(uint16_t);
 static inline unsigned char libsrng_random_combined(uint64_t *);
 static inline uint64_t libsrng_random_combined_multibyte(uint64_t *, unsigned char);
@@ -20,6 +288,28 @@ static inline uint16_t libsrng_random_halfword(uint64_t *);
 static inline uint64_t libsrng_random_seed(uint64_t *);
 static inline unsigned char libsrng_stable_random(struct libsrng_stable_random_state *);
 static inline uint16_t libsrng_random_range(uint64_t *, uint16_t);
+static inline uint16_t libsrng_reduce_range(uint64_t *, uint16_t, uint16_t);
+static inline double libsrng_random_unit(uint64_t *);
+static inline double libsrng_piecewise_map(const libsrng_piecewise_t *, double);
+static inline uint64_t libsrng_permutation_round(const libsrng_permutation_t *, uint64_t);
+static inline uint64_t libsrng_permutation_network(const libsrng_permutation_t *, uint64_t);
+static inline uint64_t libsrng_mix(uint64_t);
+static inline uint64_t libsrng_counter_key(uint64_t);
+static inline uint64_t libsrng_counter_state(uint64_t, uint64_t);
+static inline void libsrng_lanes_load(struct libsrng_lanes *, const uint64_t *);
+static inline void libsrng_lanes_store(const struct libsrng_lanes *, uint64_t *);
+static inline void libsrng_stable_random_lanes(struct libsrng_lanes *, uint32_t *);
+static inline void libsrng_random_halfword_lanes(struct libsrng_lanes *, uint16_t *);
+static inline void libsrng_random_seed_lanes(struct libsrng_lanes *, uint64_t *);
+static inline uint64_t libsrng_regular_state(uint64_t);
+static inline int libsrng_degenerate_state(uint64_t);
+static inline uint64_t libsrng_sequence_key(const uint64_t *, size_t);
+static inline uint64_t libsrng_sequence_fix(uint64_t);
+static inline uint64_t libsrng_hash_word(const unsigned char *, unsigned);
+static inline uint64_t libsrng_hash_key(uint64_t, const unsigned char *, size_t);
+static inline uint64_t libsrng_pool_get(const libsrng_pool_t *, size_t);
+static inline void libsrng_pool_put(libsrng_pool_t *, size_t, uint64_t);
+static inline void libsrng_pool_step_lanes(libsrng_pool_t *, const size_t *, size_t, uint16_t, uint16_t *);
 
 #define HALFWORD_LCG_MULTIPLIER             0x6329
 #define HALFWORD_LCG_ADDEND                 0x4321
@@ -35,14 +325,822 @@ static inline uint16_t libsrng_random_range(uint64_t *, uint16_t);
 #define SWITCH_TRIGGER_STATE_1  0x2b7e151628aed2a6ULL
 #define SWITCH_TRIGGER_STATE_2  0x19e3779b97f4a7c1ULL
 
+// rotation amount must match the C++ constexpr version in libsrng.h
+#define HASH_ROUND(value, word) ((value) = ((value) ^ (word)) * SEED_LCG_MULTIPLIER, \
+                                 (value) = ((value) << 31) | ((value) >> 33))
+
+// "LSRNGRC1" in little-endian order; caches written on a machine with a different byte order will not match
+#define RESEED_CACHE_SIGNATURE 0x314352474e52534cULL
+
+// trace files start with these 8 bytes, followed by one record per call: the range (2 bytes, little-endian) and the
+// number of reseeds (1 byte, or 0xff followed by 4 bytes, little-endian, for 255 or more reseeds)
+#define TRACE_SIGNATURE "LSRNGTR1"
+
+// reduces the 16-bit value in result (a variable) to the range given by limit, as libsrng_random does; next is an
+// expression that generates another value, for when the current one must be rejected
+#define REDUCE_RANGE(result, limit, next) do {                        \
+  if (!((limit) & ((limit) - 1)))                                     \
+    (result) &= (limit) - 1;                                          \
+  else {                                                              \
+    uint16_t resampling_limit = 0x10000 % (limit);                    \
+    if ((result) < (limit))                                           \
+      while ((result) < resampling_limit) {                           \
+        STATS_COUNT(STATS_REJECTIONS, 1);                             \
+        PROBE2(rejection, (result), (limit));                         \
+        (result) = (next);                                            \
+      }                                                               \
+    (result) %= (limit);                                              \
+  }                                                                   \
+} while (0)
+
+#define POOL_ALIGNMENT 64
+#define POOL_ARRAY_SIZE(bytes) (((bytes) + POOL_ALIGNMENT - 1) & ~(size_t) (POOL_ALIGNMENT - 1))
+
 #define STABLE_RANDOM_NEXT_LINEAR(s) ((s) -> linear *= 73, (s) -> linear += 29, (s) -> linear)
+// the low byte of a 32-bit LCG step is the 8-bit LCG step, so the value is only truncated when it's used (this keeps
+// compilers from narrowing the multiplication to an 8-bit one, which most vector instruction sets don't have)
+#define LANES_NEXT_LINEAR(value) ((value) * 73 + 29)
+// selections are done through masks (all bits set or clear) rather than conditionals, because compilers don't always
+// manage to turn conditionals on values of different widths into vector instructions
+#define LANES_MASK(condition) (-(uint32_t) (condition))
+#define LANES_SELECT(mask, selected, other) (((mask) & (selected)) | (~(mask) & (other)))
 
 uint16_t libsrng_random (uint64_t * state, uint16_t range, unsigned reseed) {
   if (!state) return 0;
+  PROBE3(random_entry, state, range, reseed);
+#if LIBSRNG_TRACE
+  if (libsrng_trace_file) libsrng_trace_record(range, reseed);
+#endif
   while (reseed --) *state = libsrng_random_seed(state);
+  uint16_t result = libsrng_random_range(state, range);
+  PROBE2(random_return, state, result);
+  return result;
+}
+
+double libsrng_random_double (uint64_t * state) {
+  if (!state) return 0;
+  return libsrng_random_unit(state);
+}
+
+#if LIBSRNG_TRACE
+int libsrng_trace_start (const char * filename) {
+  if (libsrng_trace_file || !filename) return 0;
+  FILE * file = fopen(filename, "wb");
+  if (!file) return 0;
+  if (fwrite(TRACE_SIGNATURE, 1, 8, file) != 8) {
+    fclose(file);
+    return 0;
+  }
+  libsrng_trace_file = file;
+  return 1;
+}
+
+int libsrng_trace_stop (void) {
+  if (!libsrng_trace_file) return 0;
+  int result = !fclose(libsrng_trace_file);
+  libsrng_trace_file = NULL;
+  return result;
+}
+
+static void libsrng_trace_record (uint16_t range, unsigned reseed) {
+  // a single write for each record, so that records from different threads are never interleaved
+  unsigned char record[7] = {range, range >> 8, reseed};
+  size_t size = 3;
+  if (reseed >= 0xff) {
+    record[2] = 0xff;
+    for (; size < 7; size ++) record[size] = reseed >> (8 * (size - 3));
+  }
+  fwrite(record, 1, size, libsrng_trace_file);
+}
+#endif
+
+#if LIBSRNG_STATS
+void libsrng_stats (libsrng_stats_t * stats) {
+  if (!stats) return;
+  uint64_t totals[STATS_COUNTERS] = {0};
+  unsigned counter;
+#if LIBSRNG_THREADS
+  const struct libsrng_stats_block * block;
+  for (block = atomic_load_explicit(&libsrng_stats_blocks, memory_order_acquire); block; block = block -> next)
+    for (counter = 0; counter < STATS_COUNTERS; counter ++)
+      totals[counter] += atomic_load_explicit(block -> counters + counter, memory_order_relaxed);
+#else
+  for (counter = 0; counter < STATS_COUNTERS; counter ++) totals[counter] = libsrng_stats_counters[counter];
+#endif
+  stats -> rejections = totals[STATS_REJECTIONS];
+  stats -> switches = totals[STATS_SWITCHES];
+  stats -> short_cycles = totals[STATS_SHORT_CYCLES];
+  stats -> reseeds = totals[STATS_RESEEDS];
+}
+
+#if LIBSRNG_THREADS
+static struct libsrng_stats_block * libsrng_stats_claim (void) {
+  // takes over the block of a thread that exited, or allocates a new one; returns null if that fails
+  call_once(&libsrng_stats_once, &libsrng_stats_init);
+  struct libsrng_stats_block * block;
+  for (block = atomic_load_explicit(&libsrng_stats_blocks, memory_order_acquire); block; block = block -> next) {
+    int expected = 0;
+    if (atomic_compare_exchange_strong_explicit(&block -> owned, &expected, 1, memory_order_acquire, memory_order_relaxed))
+      break;
+  }
+  if (!block) {
+    if (!(block = malloc(sizeof *block))) return NULL;
+    unsigned counter;
+    for (counter = 0; counter < STATS_COUNTERS; counter ++) atomic_init(block -> counters + counter, 0);
+    atomic_init(&block -> owned, 1);
+    block -> next = atomic_load_explicit(&libsrng_stats_blocks, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&libsrng_stats_blocks, &block -> next, block, memory_order_release,
+                                                  memory_order_relaxed));
+  }
+  // without a key, the block is never released when the thread exits (which only wastes the block)
+  if (libsrng_stats_key_created) tss_set(libsrng_stats_key, block);
+  libsrng_stats_local = block;
+  return block;
+}
+
+static void libsrng_stats_init (void) {
+  libsrng_stats_key_created = tss_create(&libsrng_stats_key, &libsrng_stats_release) == thrd_success;
+}
+
+static void libsrng_stats_release (void * block) {
+  // called when a thread exits; the thread claims a new block if it counts any more events from here on
+  libsrng_stats_local = NULL;
+  atomic_store_explicit(&((struct libsrng_stats_block *) block) -> owned, 0, memory_order_release);
+}
+#endif
+#endif
+
+libsrng_piecewise_t * libsrng_piecewise_create (const double * edges, const double * weights, unsigned bins, int linear) {
+  if (!(edges && weights && bins)) return NULL;
+  // reject tables whose size would overflow (the loops below also need bins + 1 to fit in an unsigned)
+  size_t limit = ((size_t) -1 - sizeof(struct libsrng_piecewise)) / (4 * sizeof(double));
+  if ((bins == (unsigned) -1) || (bins >= limit)) return NULL;
+  unsigned count, weight_count = bins + !!linear;
+  // edges, cumulative distribution and (for linear distributions) densities, followed by the guide table
+  size_t values = (size_t) (bins + 1) * (linear ? 3 : 2);
+  // the edges must be finite, and so must the bin widths: sampling computes an edge plus a fraction of a width
+  for (count = 0; count < bins; count ++)
+    if (!(edges[count + 1] > edges[count]) || !isfinite(edges[count]) || !isfinite(edges[count + 1] - edges[count]))
+      return NULL;
+  double total = 0;
+  for (count = 0; count < weight_count; count ++) if (!(weights[count] >= 0)) return NULL;
+  for (count = 0; count < bins; count ++)
+    total += linear ? (weights[count] + weights[count + 1]) * (edges[count + 1] - edges[count]) : weights[count];
+  if (!(total > 0) || !isfinite(total)) return NULL;
+  libsrng_piecewise_t * distribution = malloc(sizeof *distribution + values * sizeof(double) + bins * sizeof(unsigned));
+  if (!distribution) return NULL;
+  distribution -> bins = bins;
+  distribution -> linear = !!linear;
+  double * edge_values = distribution -> data;
+  double * cdf = edge_values + bins + 1;
+  double * densities = linear ? cdf + bins + 1 : NULL;
+  unsigned * guide = (unsigned *) (distribution -> data + values);
+  for (count = 0; count <= bins; count ++) edge_values[count] = edges[count];
+  if (densities) for (count = 0; count <= bins; count ++) densities[count] = weights[count];
+  double cumulative = 0;
+  for (count = 0; count < bins; count ++) {
+    cdf[count] = cumulative / total;
+    cumulative += linear ? (weights[count] + weights[count + 1]) * (edges[count + 1] - edges[count]) : weights[count];
+  }
+  // force the last bin to end exactly at 1, so that bin searches always terminate
+  cdf[bins] = 1;
+  // guide[k] is the first bin whose upper cumulative value exceeds k / bins; starting the search there makes the
+  // expected number of search steps constant
+  unsigned bin = 0;
+  for (count = 0; count < bins; count ++) {
+    double threshold = (double) count / bins;
+    while (cdf[bin + 1] <= threshold) bin ++;
+    guide[count] = bin;
+  }
+  distribution -> edges = edge_values;
+  distribution -> densities = densities;
+  distribution -> cdf = cdf;
+  distribution -> guide = guide;
+  return distribution;
+}
+
+void libsrng_piecewise_destroy (libsrng_piecewise_t * distribution) {
+  free(distribution);
+}
+
+double libsrng_piecewise_sample (const libsrng_piecewise_t * distribution, uint64_t * state) {
+  if (!(distribution && state)) return 0;
+  return libsrng_piecewise_map(distribution, libsrng_random_unit(state));
+}
+
+void libsrng_piecewise_sample_many (const libsrng_piecewise_t * distribution, uint64_t * state, double * result,
+                                    size_t count) {
+  if (!(distribution && state && result)) return;
+  size_t current;
+  // generate all the uniform values first: the generator is inherently sequential, but the table lookups aren't
+  for (current = 0; current < count; current ++) result[current] = libsrng_random_unit(state);
+  for (current = 0; current < count; current ++) result[current] = libsrng_piecewise_map(distribution, result[current]);
+}
+
+void libsrng_permutation_init (libsrng_permutation_t * permutation, uint64_t * state, uint64_t size) {
+  if (!(permutation && state)) return;
+  unsigned count, bits = 2;
+  permutation -> size = size;
+  // the network permutes a domain with an even number of bits, at most four times larger than the requested size;
+  // values that fall outside of the requested range are mapped again until they fall within it (cycle walking)
+  if (!size)
+    bits = 64;
+  else
+    while ((bits < 64) && ((size - 1) >> bits)) bits ++;
+  permutation -> half_bits = (bits + 1) >> 1;
+  for (count = 0; count < (sizeof permutation -> keys / sizeof *permutation -> keys); count ++) {
+    uint64_t key = 0;
+    unsigned part;
+    for (part = 0; part < 4; part ++) key = (key << 16) | libsrng_random_halfword(state);
+    permutation -> keys[count] = key;
+  }
+}
+
+uint64_t libsrng_index_to_permuted (const libsrng_permutation_t * permutation, uint64_t index) {
+  if (!permutation || (permutation -> size && (index >= permutation -> size))) return index;
+  do
+    index = libsrng_permutation_network(permutation, index);
+  while (permutation -> size && (index >= permutation -> size));
+  return index;
+}
+
+void libsrng_index_to_permuted_many (const libsrng_permutation_t * permutation, uint64_t first, uint64_t * result,
+                                     size_t count) {
+  if (!(permutation && result)) return;
+  size_t current;
+  // run the network once for every index without any branches, so that the loop can be vectorized, and then fix up
+  // the (few) values that need cycle walking or that were out of range to begin with
+  for (current = 0; current < count; current ++) result[current] = libsrng_permutation_network(permutation, first + current);
+  if (!permutation -> size) return;
+  for (current = 0; current < count; current ++)
+    if ((first + current) >= permutation -> size)
+      result[current] = first + current;
+    else
+      while (result[current] >= permutation -> size) result[current] = libsrng_permutation_network(permutation, result[current]);
+}
+
+uint64_t libsrng_at_state (uint64_t seed, uint64_t counter) {
+  return libsrng_counter_state(libsrng_counter_key(seed), counter);
+}
+
+uint16_t libsrng_at (uint64_t seed, uint64_t counter) {
+  uint64_t state = libsrng_at_state(seed, counter);
+  return libsrng_random_halfword(&state);
+}
+
+uint16_t libsrng_at_range (uint64_t seed, uint64_t counter, uint16_t range) {
+  uint64_t state = libsrng_at_state(seed, counter);
+  return libsrng_random_range(&state, range);
+}
+
+void libsrng_at_many (uint64_t seed, uint64_t first, uint16_t * result, size_t count) {
+  if (!result) return;
+  uint64_t key = libsrng_counter_key(seed), states[LANE_COUNT];
+  struct libsrng_lanes lanes;
+  size_t current;
+  unsigned lane;
+  for (current = 0; LIBSRNG_LANES && ((count - current) >= LANE_COUNT); current += LANE_COUNT) {
+    for (lane = 0; lane < LANE_COUNT; lane ++) states[lane] = libsrng_counter_state(key, first + current + lane);
+    libsrng_lanes_load(&lanes, states);
+    libsrng_random_halfword_lanes(&lanes, result + current);
+  }
+  for (; current < count; current ++) {
+    *states = libsrng_counter_state(key, first + current);
+    result[current] = libsrng_random_halfword(states);
+  }
+}
+
+void libsrng_fill_grid2d (uint64_t seed, const int64_t origin[2], const uint32_t dimensions[2], uint16_t * result) {
+  if (!(origin && dimensions && result)) return;
+  uint32_t row;
+  // every row is a counter-based sequence along x, keyed by the row's state; the rows use the lane kernels
+  for (row = 0; row < dimensions[1]; row ++, result += dimensions[0])
+    libsrng_at_many(libsrng_at_state(seed, (uint64_t) origin[1] + row), origin[0], result, dimensions[0]);
+}
+
+void libsrng_fill_grid3d (uint64_t seed, const int64_t origin[3], const uint32_t dimensions[3], uint16_t * result) {
+  if (!(origin && dimensions && result)) return;
+  uint32_t plane;
+  // each plane is a 2D grid keyed by the plane's state
+  for (plane = 0; plane < dimensions[2]; plane ++, result += (size_t) dimensions[0] * dimensions[1])
+    libsrng_fill_grid2d(libsrng_at_state(seed, (uint64_t) origin[2] + plane), origin, dimensions, result);
+}
+
+uint64_t libsrng_split (uint64_t * parent) {
+  if (!parent) return 0;
+  uint64_t child = libsrng_mix(*parent ^ SEED_LCG_SECOND_ADDEND);
+  // full-period LCG (odd addend, multiplier congruent to 1 mod 4): a parent won't repeat until it's split 2^64 times
+  *parent = *parent * SEED_LCG_MULTIPLIER + SEED_LCG_FIRST_ADDEND;
+  return child;
+}
+
+uint64_t libsrng_stream_from_key (uint64_t root, const void * key, size_t length) {
+  // a null key hashes as an empty one; libsrng_hash_key still offsets the pointer, so it can't be null
+  static const unsigned char empty[1];
+  if (!key) {
+    key = empty;
+    length = 0;
+  }
+  return libsrng_hash_key(root, key, length);
+}
+
+uint64_t libsrng_stream_from_id (uint64_t root, uint64_t id) {
+  unsigned char key[8];
+  unsigned count;
+  for (count = 0; count < sizeof key; count ++, id >>= 8) key[count] = id;
+  return libsrng_hash_key(root, key, sizeof key);
+}
+
+uint64_t libsrng_stream_from_path (uint64_t root, const char * path) {
+  if (!path) return root;
+  size_t length;
+  while (*path) {
+    for (length = 0; path[length] && (path[length] != '/'); length ++);
+    if (length) root = libsrng_hash_key(root, (const unsigned char *) path, length);
+    path += length;
+    if (*path) path ++;
+  }
+  return root;
+}
+
+size_t libsrng_reseed_cache_size (unsigned interval, unsigned limit) {
+  if (!interval) return 0;
+  return sizeof(struct libsrng_reseed_cache) + ((size_t) (limit / interval) + 1) * sizeof(uint64_t);
+}
+
+const libsrng_reseed_cache_t * libsrng_reseed_cache_build (void * buffer, size_t size, uint64_t root, unsigned interval,
+                                                           unsigned limit) {
+  if (!buffer || !interval || (size < libsrng_reseed_cache_size(interval, limit))) return NULL;
+  // the checkpoint count must fit in 32 bits
+  if ((limit / interval) >= 0xffffffffu) return NULL;
+  // written through a volatile pointer, so that the compiler keeps the stores in order (and doesn't drop the first
+  // store to the signature): the signature is cleared first and written last, so that a cache that wasn't completely
+  // built (for instance, by an interrupted process, including one that was rebuilding a cache in place) is rejected
+  volatile libsrng_reseed_cache_t * cache = buffer;
+  uint32_t count, checkpoints = limit / interval + 1;
+  unsigned step;
+  cache -> signature = 0;
+  cache -> root = *cache -> checkpoints = root;
+  cache -> interval = interval;
+  cache -> count = checkpoints;
+  for (count = 1; count < checkpoints; count ++) {
+    for (step = 0; step < interval; step ++) root = libsrng_random_seed(&root);
+    cache -> checkpoints[count] = root;
+  }
+  cache -> signature = RESEED_CACHE_SIGNATURE;
+  return (const libsrng_reseed_cache_t *) cache;
+}
+
+const libsrng_reseed_cache_t * libsrng_reseed_cache_attach (const void * buffer, size_t size) {
+  const libsrng_reseed_cache_t * cache = buffer;
+  if (!cache || (size < sizeof *cache) || (cache -> signature != RESEED_CACHE_SIGNATURE) || !cache -> interval ||
+      !cache -> count || ((size - sizeof *cache) / sizeof(uint64_t) < cache -> count) || (*cache -> checkpoints != cache -> root))
+    return NULL;
+  return cache;
+}
+
+uint64_t libsrng_reseed_cache_state (const libsrng_reseed_cache_t * cache, unsigned reseed) {
+  if (!cache) return 0;
+  uint32_t index = reseed / cache -> interval;
+  if (index >= cache -> count) index = cache -> count - 1;
+  uint64_t state = cache -> checkpoints[index];
+  for (reseed -= index * cache -> interval; reseed; reseed --) state = libsrng_random_seed(&state);
+  return state;
+}
+
+uint16_t libsrng_random_cached (const libsrng_reseed_cache_t * cache, uint64_t * state, uint16_t range, unsigned reseed) {
+  if (!state) return 0;
+  if (cache && reseed && (*state == cache -> root))
+    *state = libsrng_reseed_cache_state(cache, reseed);
+  else
+    while (reseed --) *state = libsrng_random_seed(state);
   return libsrng_random_range(state, range);
 }
 
+void libsrng_seed_seq (const uint64_t * seeds, size_t seed_count, uint64_t * states, size_t count) {
+  if (!states || (seed_count && !seeds)) return;
+  uint64_t key = libsrng_sequence_key(seeds, seed_count);
+  size_t current;
+  // branch-free pass over all states, which can be vectorized
+  for (current = 0; current < count; current ++) states[current] = libsrng_regular_state(libsrng_counter_state(key, current));
+  // degenerate states are too rare (239 out of over 13 million) to handle in the main loop
+  for (current = 0; current < count; current ++) states[current] = libsrng_sequence_fix(states[current]);
+}
+
+void libsrng_seed_many (const uint64_t * parents, uint64_t * children, size_t count, unsigned depth) {
+  if (!(parents && children)) return;
+  struct libsrng_lanes lanes;
+  uint64_t states[LANE_COUNT];
+  size_t current;
+  unsigned lane, remaining;
+  for (current = 0; LIBSRNG_LANES && ((count - current) >= LANE_COUNT); current += LANE_COUNT) {
+    // copy the parents first, so that children can be the same array
+    for (lane = 0; lane < LANE_COUNT; lane ++) states[lane] = parents[current + lane];
+    for (remaining = depth; remaining; remaining --) {
+      // same probe as libsrng_random_seed, once per lane
+      for (lane = 0; lane < LANE_COUNT; lane ++) PROBE1(reseed, states[lane]);
+      libsrng_lanes_load(&lanes, states);
+      libsrng_random_seed_lanes(&lanes, states);
+    }
+    STATS_COUNT(STATS_RESEEDS, (uint64_t) depth * LANE_COUNT);
+    for (lane = 0; lane < LANE_COUNT; lane ++) children[current + lane] = states[lane];
+  }
+  for (; current < count; current ++) {
+    *states = parents[current];
+    for (remaining = depth; remaining; remaining --) *states = libsrng_random_seed(states);
+    children[current] = *states;
+  }
+}
+
+void libsrng_buffered_init (libsrng_buffered_t * buffered, uint64_t state) {
+  if (!buffered) return;
+  buffered -> state = buffered -> base = state;
+  // an exhausted buffer: the first value will generate a new one
+  buffered -> position = LIBSRNG_BUFFER_SIZE;
+}
+
+uint64_t libsrng_buffered_state (const libsrng_buffered_t * buffered) {
+  if (!buffered) return 0;
+  if (buffered -> position >= LIBSRNG_BUFFER_SIZE) return buffered -> state;
+  // replay the values already taken from the buffer on the state it was generated from
+  uint64_t state = buffered -> base;
+  unsigned position;
+  for (position = 0; position < buffered -> position; position ++) libsrng_random_halfword(&state);
+  return state;
+}
+
+void libsrng_buffered_refill (libsrng_buffered_t * buffered) {
+  if (!buffered) return;
+  // a single state can only be stepped sequentially, so the gain comes from keeping the state in registers for the
+  // whole buffer instead of loading and storing it for every value
+  uint64_t state = buffered -> base = buffered -> state;
+  unsigned position;
+  for (position = 0; position < LIBSRNG_BUFFER_SIZE; position ++) buffered -> buffer[position] = libsrng_random_halfword(&state);
+  buffered -> state = state;
+  buffered -> position = 0;
+}
+
+libsrng_pool_t * libsrng_pool_create (const uint64_t * states, size_t count) {
+  // one 32-bit array and four byte arrays, each padded to the alignment, plus room to align the first one
+  if (count > (((size_t) -1 - sizeof(struct libsrng_pool)) / (sizeof(uint32_t) + 4) - 5 * POOL_ALIGNMENT)) return NULL;
+  size_t shift_size = POOL_ARRAY_SIZE(count * sizeof(uint32_t)), byte_size = POOL_ARRAY_SIZE(count);
+  libsrng_pool_t * pool = malloc(sizeof *pool + POOL_ALIGNMENT + shift_size + 4 * byte_size);
+  if (!pool) return NULL;
+  unsigned char * storage = (unsigned char *) (pool + 1);
+  storage += (POOL_ALIGNMENT - ((uintptr_t) storage % POOL_ALIGNMENT)) % POOL_ALIGNMENT;
+  pool -> count = count;
+  pool -> shift = (uint32_t *) storage;
+  pool -> carry = storage + shift_size;
+  pool -> current = pool -> carry + byte_size;
+  pool -> prev = pool -> current + byte_size;
+  pool -> linear = pool -> prev + byte_size;
+  size_t current;
+  for (current = 0; current < count; current ++) libsrng_pool_put(pool, current, states ? states[current] : 0);
+  return pool;
+}
+
+void libsrng_pool_destroy (libsrng_pool_t * pool) {
+  free(pool);
+}
+
+size_t libsrng_pool_size (const libsrng_pool_t * pool) {
+  return pool ? pool -> count : 0;
+}
+
+void libsrng_pool_import (libsrng_pool_t * pool, size_t first, const uint64_t * states, size_t count) {
+  if (!(pool && states) || (first > pool -> count) || (count > (pool -> count - first))) return;
+  size_t current;
+  for (current = 0; current < count; current ++) libsrng_pool_put(pool, first + current, states[current]);
+}
+
+void libsrng_pool_export (const libsrng_pool_t * pool, size_t first, uint64_t * states, size_t count) {
+  if (!(pool && states) || (first > pool -> count) || (count > (pool -> count - first))) return;
+  size_t current;
+  for (current = 0; current < count; current ++) states[current] = libsrng_pool_get(pool, first + current);
+}
+
+void libsrng_pool_step (libsrng_pool_t * pool, const size_t * indexes, size_t count, uint16_t range, uint16_t * result) {
+  if (!(pool && indexes && result)) return;
+  size_t current;
+  if (range == 1) {
+    for (current = 0; current < count; current ++) result[current] = 0;
+    return;
+  }
+  for (current = 0; LIBSRNG_LANES && ((count - current) >= LANE_COUNT); current += LANE_COUNT)
+    libsrng_pool_step_lanes(pool, indexes + current, 0, range, result + current);
+  for (; current < count; current ++) {
+    uint64_t state = libsrng_pool_get(pool, indexes[current]);
+    result[current] = libsrng_random_range(&state, range);
+    libsrng_pool_put(pool, indexes[current], state);
+  }
+}
+
+void libsrng_pool_step_all (libsrng_pool_t * pool, uint16_t range, uint16_t * result) {
+  if (!(pool && result)) return;
+  size_t current;
+  if (range == 1) {
+    for (current = 0; current < pool -> count; current ++) result[current] = 0;
+    return;
+  }
+  for (current = 0; LIBSRNG_LANES && ((pool -> count - current) >= LANE_COUNT); current += LANE_COUNT)
+    libsrng_pool_step_lanes(pool, NULL, current, range, result + current);
+  for (; current < pool -> count; current ++) {
+    uint64_t state = libsrng_pool_get(pool, current);
+    result[current] = libsrng_random_range(&state, range);
+    libsrng_pool_put(pool, current, state);
+  }
+}
+
+#if LIBSRNG_THREADS
+void libsrng_tl_seed (uint64_t seed) {
+  // the calling thread takes the first state of the seed's expansion right away (instead of when it first uses its
+  // state), so that other threads can't take it first; the ordinals restart after it
+  atomic_store_explicit(&libsrng_process_seed, seed, memory_order_relaxed);
+  atomic_store_explicit(&libsrng_thread_count, 1, memory_order_relaxed);
+  libsrng_thread_state = libsrng_sequence_fix(libsrng_regular_state(libsrng_counter_state(libsrng_sequence_key(&seed, 1), 0)));
+}
+
+uint64_t * libsrng_tl_state (void) {
+  if (!libsrng_thread_state) libsrng_thread_state = libsrng_tl_initial_state();
+  return &libsrng_thread_state;
+}
+
+uint16_t libsrng_tl_random (uint16_t range) {
+  // working on a local copy lets the compiler keep the state in registers, so that the thread-local variable is only
+  // accessed twice: a load at the beginning and a store at the end
+  uint64_t state = libsrng_thread_state;
+  if (!state) state = libsrng_tl_initial_state();
+  uint16_t result = libsrng_random_range(&state, range);
+  libsrng_thread_state = state;
+  return result;
+}
+
+double libsrng_tl_double (void) {
+  uint64_t state = libsrng_thread_state;
+  if (!state) state = libsrng_tl_initial_state();
+  double result = libsrng_random_unit(&state);
+  libsrng_thread_state = state;
+  return result;
+}
+
+void libsrng_cpu_seed (uint64_t seed) {
+  libsrng_tl_seed(seed);
+#if LIBSRNG_RSEQ
+  unsigned cpu;
+  for (cpu = 0; cpu < LIBSRNG_CPU_COUNT; cpu ++) atomic_store_explicit(&libsrng_cpu_slots[cpu].state, 0, memory_order_relaxed);
+#endif
+}
+
+uint16_t libsrng_cpu_random (uint16_t range) {
+#if LIBSRNG_RSEQ
+  // the state is stepped on a local copy and then committed, which only fails if the thread was preempted, migrated or
+  // interrupted by a signal in between (and then the slot is looked up again, since the CPU may have changed)
+  struct libsrng_cpu_slot * slot;
+  while ((slot = libsrng_cpu_slot())) {
+    uint64_t expected = atomic_load_explicit(&slot -> state, memory_order_relaxed);
+    uint64_t state = expected ? expected : libsrng_cpu_initial_state(slot);
+    uint16_t result = libsrng_random_range(&state, range);
+    if (libsrng_cpu_commit(slot, expected, state)) return result;
+  }
+#endif
+  return libsrng_tl_random(range);
+}
+
+double libsrng_cpu_double (void) {
+#if LIBSRNG_RSEQ
+  struct libsrng_cpu_slot * slot;
+  while ((slot = libsrng_cpu_slot())) {
+    uint64_t expected = atomic_load_explicit(&slot -> state, memory_order_relaxed);
+    uint64_t state = expected ? expected : libsrng_cpu_initial_state(slot);
+    double result = libsrng_random_unit(&state);
+    if (libsrng_cpu_commit(slot, expected, state)) return result;
+  }
+#endif
+  return libsrng_tl_double();
+}
+
+libsrng_shared_t * libsrng_shared_create (uint64_t seed) {
+  libsrng_shared_t * shared = aligned_alloc(_Alignof(libsrng_shared_t), sizeof *shared);
+  if (!shared) return NULL;
+  shared -> seed = seed;
+  atomic_init(&shared -> next_block, 0);
+  return shared;
+}
+
+void libsrng_shared_destroy (libsrng_shared_t * shared) {
+  free(shared);
+}
+
+void libsrng_shared_reader_init (libsrng_shared_reader_t * reader, libsrng_shared_t * shared) {
+  if (!reader) return;
+  reader -> shared = shared;
+  reader -> block = 0;
+  // an exhausted buffer: the first value will reserve a block
+  reader -> position = LIBSRNG_SHARED_BLOCK_SIZE;
+}
+
+uint16_t libsrng_shared_random (libsrng_shared_reader_t * reader, uint16_t range) {
+  if (!(reader && reader -> shared) || (range == 1)) return 0;
+  if (reader -> position >= LIBSRNG_SHARED_BLOCK_SIZE) libsrng_shared_fill(reader);
+  uint16_t result = reader -> buffer[reader -> position ++];
+  REDUCE_RANGE(result, range, ((reader -> position >= LIBSRNG_SHARED_BLOCK_SIZE) ? libsrng_shared_fill(reader) : (void) 0,
+                               reader -> buffer[reader -> position ++]));
+  return result;
+}
+
+static void libsrng_shared_fill (libsrng_shared_reader_t * reader) {
+  // the stream has no jump-ahead, so every block is generated from its own counter-based state instead; the stream
+  // is the concatenation of all blocks in order, regardless of which threads reserve them
+  reader -> block = atomic_fetch_add_explicit(&reader -> shared -> next_block, 1, memory_order_relaxed);
+  uint64_t state = libsrng_at_state(reader -> shared -> seed, reader -> block);
+  unsigned position;
+  for (position = 0; position < LIBSRNG_SHARED_BLOCK_SIZE; position ++)
+    reader -> buffer[position] = libsrng_random_halfword(&state);
+  reader -> position = 0;
+}
+
+libsrng_producer_t * libsrng_producer_create (const uint64_t * states, size_t count) {
+  if (!(states && count) || (count > ((size_t) -1 / sizeof(struct libsrng_consumer)))) return NULL;
+  libsrng_producer_t * producer = malloc(sizeof *producer);
+  if (!producer) return NULL;
+  // the size of the structure is a multiple of its alignment, as aligned_alloc requires
+  producer -> consumers = aligned_alloc(_Alignof(struct libsrng_consumer), count * sizeof *producer -> consumers);
+  if (!producer -> consumers) goto fail;
+  producer -> count = count;
+  size_t current;
+  for (current = 0; current < count; current ++) {
+    struct libsrng_consumer * consumer = producer -> consumers + current;
+    atomic_init(&consumer -> head, 0);
+    atomic_init(&consumer -> tail, 0);
+    atomic_init(&consumer -> pages, 0);
+    atomic_init(&consumer -> stalls, 0);
+    atomic_init(&consumer -> stall_time, 0);
+    consumer -> page = NULL;
+    consumer -> position = PRODUCER_PAGE_SIZE;
+    consumer -> producer = producer;
+    consumer -> state = states[current];
+  }
+  atomic_init(&producer -> stop, 0);
+  atomic_init(&producer -> sleeping, 0);
+  if (mtx_init(&producer -> lock, mtx_plain) != thrd_success) goto fail_lock;
+  if (cnd_init(&producer -> wake) != thrd_success) goto fail_wake;
+  if (thrd_create(&producer -> thread, &libsrng_producer_run, producer) == thrd_success) return producer;
+  cnd_destroy(&producer -> wake);
+  fail_wake:
+  mtx_destroy(&producer -> lock);
+  fail_lock:
+  free(producer -> consumers);
+  fail:
+  free(producer);
+  return NULL;
+}
+
+void libsrng_producer_destroy (libsrng_producer_t * producer) {
+  if (!producer) return;
+  atomic_store_explicit(&producer -> stop, 1, memory_order_relaxed);
+  libsrng_producer_wake(producer);
+  thrd_join(producer -> thread, NULL);
+  cnd_destroy(&producer -> wake);
+  mtx_destroy(&producer -> lock);
+  free(producer -> consumers);
+  free(producer);
+}
+
+libsrng_consumer_t * libsrng_producer_consumer (libsrng_producer_t * producer, size_t index) {
+  if (!producer || (index >= producer -> count)) return NULL;
+  return producer -> consumers + index;
+}
+
+uint16_t libsrng_consumer_random (libsrng_consumer_t * consumer, uint16_t range) {
+  if (!consumer || (range == 1)) return 0;
+  uint16_t result = libsrng_consumer_halfword(consumer);
+  REDUCE_RANGE(result, range, libsrng_consumer_halfword(consumer));
+  return result;
+}
+
+void libsrng_consumer_stats (const libsrng_consumer_t * consumer, libsrng_consumer_stats_t * stats) {
+  if (!(consumer && stats)) return;
+  stats -> pages = atomic_load_explicit(&consumer -> pages, memory_order_relaxed);
+  stats -> stalls = atomic_load_explicit(&consumer -> stalls, memory_order_relaxed);
+  stats -> stall_time = atomic_load_explicit(&consumer -> stall_time, memory_order_relaxed);
+}
+
+static inline uint16_t libsrng_consumer_halfword (libsrng_consumer_t * consumer) {
+  if (consumer -> position >= PRODUCER_PAGE_SIZE) libsrng_consumer_next_page(consumer);
+  return consumer -> page[consumer -> position ++];
+}
+
+static void libsrng_consumer_next_page (libsrng_consumer_t * consumer) {
+  uint64_t head = atomic_load_explicit(&consumer -> head, memory_order_relaxed);
+  // hand the finished page back to the producer (there is none before the first page)
+  if (consumer -> page) {
+    atomic_store_explicit(&consumer -> head, ++ head, memory_order_release);
+    // pairs with the fence in libsrng_producer_run: either the producer sees the page before it sleeps, or this thread
+    // sees that it's sleeping and wakes it up
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&consumer -> producer -> sleeping, memory_order_relaxed)) libsrng_producer_wake(consumer -> producer);
+  }
+  if (atomic_load_explicit(&consumer -> tail, memory_order_acquire) == head) {
+    // the consumer outran the producer; the timing is only done here, so it costs nothing while the producer keeps up
+    struct timespec start, end;
+    STALL_CLOCK(&start);
+    do thrd_yield(); while (atomic_load_explicit(&consumer -> tail, memory_order_acquire) == head);
+    STALL_CLOCK(&end);
+    int64_t elapsed = (int64_t) (end.tv_sec - start.tv_sec) * 1000000000 + (end.tv_nsec - start.tv_nsec);
+    atomic_store_explicit(&consumer -> stalls, atomic_load_explicit(&consumer -> stalls, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    if (elapsed > 0) atomic_store_explicit(&consumer -> stall_time, atomic_load_explicit(&consumer -> stall_time,
+                                           memory_order_relaxed) + elapsed, memory_order_relaxed);
+  }
+  consumer -> page = consumer -> buffers[head % 2];
+  consumer -> position = 0;
+  atomic_store_explicit(&consumer -> pages, atomic_load_explicit(&consumer -> pages, memory_order_relaxed) + 1,
+                        memory_order_relaxed);
+}
+
+static int libsrng_producer_run (void * argument) {
+  libsrng_producer_t * producer = argument;
+  unsigned spins = 0;
+  while (!atomic_load_explicit(&producer -> stop, memory_order_relaxed)) {
+    int idle = 1;
+    size_t current;
+    for (current = 0; current < producer -> count; current ++) {
+      struct libsrng_consumer * consumer = producer -> consumers + current;
+      uint64_t tail = atomic_load_explicit(&consumer -> tail, memory_order_relaxed);
+      // the acquire load ensures that the consumer is done reading the page before it is overwritten
+      if ((tail - atomic_load_explicit(&consumer -> head, memory_order_acquire)) >= 2) continue;
+      uint16_t * page = consumer -> buffers[tail % 2];
+      uint64_t state = consumer -> state;
+      unsigned position;
+      for (position = 0; position < PRODUCER_PAGE_SIZE; position ++) page[position] = libsrng_random_halfword(&state);
+      consumer -> state = state;
+      atomic_store_explicit(&consumer -> tail, tail + 1, memory_order_release);
+      idle = 0;
+    }
+    if (!idle)
+      spins = 0;
+    else if (++ spins < PRODUCER_SPINS)
+      thrd_yield();
+    else {
+      // every page is full: sleep until a consumer hands a page back (or the producer is destroyed), instead of
+      // keeping a CPU busy while the consumers are idle
+      spins = 0;
+      mtx_lock(&producer -> lock);
+      atomic_store_explicit(&producer -> sleeping, 1, memory_order_relaxed);
+      atomic_thread_fence(memory_order_seq_cst);
+      while (!atomic_load_explicit(&producer -> stop, memory_order_relaxed) && !libsrng_producer_pending(producer))
+        cnd_wait(&producer -> wake, &producer -> lock);
+      atomic_store_explicit(&producer -> sleeping, 0, memory_order_relaxed);
+      mtx_unlock(&producer -> lock);
+    }
+  }
+  return 0;
+}
+
+static int libsrng_producer_pending (libsrng_producer_t * producer) {
+  // returns whether any consumer has a page to fill
+  size_t current;
+  for (current = 0; current < producer -> count; current ++) {
+    struct libsrng_consumer * consumer = producer -> consumers + current;
+    if ((atomic_load_explicit(&consumer -> tail, memory_order_relaxed) -
+         atomic_load_explicit(&consumer -> head, memory_order_acquire)) < 2) return 1;
+  }
+  return 0;
+}
+
+static void libsrng_producer_wake (libsrng_producer_t * producer) {
+  mtx_lock(&producer -> lock);
+  cnd_signal(&producer -> wake);
+  mtx_unlock(&producer -> lock);
+}
+
+static uint64_t libsrng_tl_initial_state (void) {
+  // same as the state at index ordinal in the expansion of the process seed by libsrng_seed_seq
+  uint64_t seed = atomic_load_explicit(&libsrng_process_seed, memory_order_relaxed);
+  uint64_t ordinal = atomic_fetch_add_explicit(&libsrng_thread_count, 1, memory_order_relaxed);
+  return libsrng_sequence_fix(libsrng_regular_state(libsrng_counter_state(libsrng_sequence_key(&seed, 1), ordinal)));
+}
+
+#if LIBSRNG_RSEQ
+static struct libsrng_cpu_slot * libsrng_cpu_slot (void) {
+  // glibc registers the rseq area at a fixed offset from the thread pointer; the kernel keeps its CPU number up to date
+  // (or negative if registration failed), and reading it costs a single load
+  if (!__rseq_size) return NULL;
+  const volatile struct rseq * area = (const volatile struct rseq *) ((char *) __builtin_thread_pointer() + __rseq_offset);
+  int32_t cpu = area -> cpu_id;
+  if ((cpu < 0) || (cpu >= LIBSRNG_CPU_COUNT)) return NULL;
+  return libsrng_cpu_slots + cpu;
+}
+
+static uint64_t libsrng_cpu_initial_state (const struct libsrng_cpu_slot * slot) {
+  // same as the state at index cpu in the expansion of {process seed, 0} by libsrng_seed_seq
+  uint64_t seeds[] = {atomic_load_explicit(&libsrng_process_seed, memory_order_relaxed), 0};
+  uint64_t cpu = slot - libsrng_cpu_slots;
+  return libsrng_sequence_fix(libsrng_regular_state(libsrng_counter_state(libsrng_sequence_key(seeds, 2), cpu)));
+}
+#endif
+#endif
+
 static inline uint16_t libsrng_random_linear (uint16_t previous) {
   return (previous * HALFWORD_LCG_MULTIPLIER + HALFWORD_LCG_ADDEND) & 0xffff;
 }
@@ -81,6 +1179,7 @@ static inline uint16_t libsrng_random_halfword (uint64_t * state) {
   unsigned char count;
   for (count = 0; count < (sizeof switch_trigger_states / sizeof *switch_trigger_states - 1); count ++)
     if (*state == switch_trigger_states[count]) {
+      STATS_COUNT(STATS_SWITCHES, 1);
       *state = switch_trigger_states[count + 1];
       break;
     }
@@ -94,6 +1193,8 @@ static inline uint16_t libsrng_random_halfword (uint64_t * state) {
 }
 
 static inline uint64_t libsrng_random_seed (uint64_t * state) {
+  STATS_COUNT(STATS_RESEEDS, 1);
+  PROBE1(reseed, *state);
   uint64_t first = libsrng_random_combined_multibyte(state, 8);
   first = first * SEED_LCG_MULTIPLIER + SEED_LCG_FIRST_ADDEND;
   uint64_t second = 0;
@@ -117,11 +1218,13 @@ static inline unsigned char libsrng_stable_random (struct libsrng_stable_random_
         state -> prev = short_cycles[p + 3];
         state -> current = short_cycles[p + 4];
         state -> carry = short_cycles[p + 5];
+        STATS_COUNT(STATS_SHORT_CYCLES, 1);
         break;
       }
     }
   else
     for (p = 0; p < (sizeof cycle_start_points - 1); p ++) if (state -> carry == cycle_start_points[p]) {
+      STATS_COUNT(STATS_SWITCHES, 1);
       state -> carry = cycle_start_points[p + 1];
       if (!state -> carry) {
         state -> prev = *short_cycles;
@@ -134,6 +1237,7 @@ static inline unsigned char libsrng_stable_random (struct libsrng_stable_random_
   if (state -> carry >= 210) state -> carry -= 210;
   p = state -> carry + state -> prev + state -> current;
   if (!p || (p == 719)) {
+    STATS_COUNT(STATS_SWITCHES, 1);
     state -> prev = STABLE_RANDOM_NEXT_LINEAR(state);
     state -> carry = STABLE_RANDOM_NEXT_LINEAR(state);
     state -> current = STABLE_RANDOM_NEXT_LINEAR(state);
@@ -158,10 +1262,372 @@ static inline unsigned char libsrng_stable_random (struct libsrng_stable_random_
 
 static inline uint16_t libsrng_random_range (uint64_t * state, uint16_t limit) {
   if (limit == 1) return 0;
-  uint16_t result = libsrng_random_halfword(state);
-  if (!(limit & (limit - 1))) return result & (limit - 1);
-  if (result >= limit) return result % limit;
-  uint16_t resampling_limit = 0x10000 % limit;
-  while (result < resampling_limit) result = libsrng_random_halfword(state);
-  return result % limit;
+  return libsrng_reduce_range(state, libsrng_random_halfword(state), limit);
+}
+
+static inline uint16_t libsrng_reduce_range (uint64_t * state, uint16_t result, uint16_t limit) {
+  // result is the first value generated by libsrng_random_range; further values are taken from state if needed
+  REDUCE_RANGE(result, limit, libsrng_random_halfword(state));
+  return result;
+}
+
+static inline uint64_t libsrng_mix (uint64_t value) {
+  // SplitMix64-style finalizer using the seed LCG multiplier; every step is invertible, so this is a bijection
+  value ^= value >> 32;
+  value *= SEED_LCG_MULTIPLIER;
+  value ^= value >> 29;
+  value *= SEED_LCG_MULTIPLIER;
+  return value ^ (value >> 32);
+}
+
+static inline uint64_t libsrng_counter_key (uint64_t seed) {
+  return libsrng_mix(seed * SEED_LCG_MULTIPLIER + SEED_LCG_FIRST_ADDEND);
+}
+
+static inline uint64_t libsrng_counter_state (uint64_t key, uint64_t counter) {
+  // bijective in the counter for any fixed key, so different counters never share a state
+  return libsrng_mix(key ^ (counter * SEED_LCG_MULTIPLIER + SEED_LCG_SECOND_ADDEND));
+}
+
+static inline void libsrng_lanes_load (struct libsrng_lanes * lanes, const uint64_t * states) {
+  unsigned lane;
+  for (lane = 0; lane < LANE_COUNT; lane ++) {
+    lanes -> shift[lane] = states[lane];
+    lanes -> carry[lane] = (states[lane] >> 32) & 0xff;
+    lanes -> current[lane] = (states[lane] >> 40) & 0xff;
+    lanes -> prev[lane] = (states[lane] >> 48) & 0xff;
+    lanes -> linear[lane] = states[lane] >> 56;
+  }
+}
+
+static inline void libsrng_lanes_store (const struct libsrng_lanes * lanes, uint64_t * states) {
+  unsigned lane;
+  for (lane = 0; lane < LANE_COUNT; lane ++)
+    states[lane] = ((uint64_t) lanes -> shift[lane]) | ((uint64_t) lanes -> carry[lane] << 32) |
+                   ((uint64_t) lanes -> current[lane] << 40) | ((uint64_t) lanes -> prev[lane] << 48) |
+                   ((uint64_t) lanes -> linear[lane] << 56);
+}
+
+static inline void libsrng_stable_random_lanes (struct libsrng_lanes * restrict lanes, uint32_t * restrict result) {
+  // same as libsrng_stable_random, but every conditional is evaluated for all lanes and its result is selected
+  // the tables must match the ones in libsrng_stable_random
+  const unsigned char cycle_start_points[] = {1, 2, 4, 8, 13, 17, 23, 26, 29, 58, 0};
+  const unsigned char short_cycles[] = {0x72, 0x4f, 0x9f, 0x7b, 0x1a, 0x7b, 0x84, 0xe5, 0x56, 0x8d, 0xb0, 0x32, 0, 0, 1};
+  unsigned lane, p;
+  for (lane = 0; lane < LANE_COUNT; lane ++) {
+    uint32_t shift = lanes -> shift[lane], carry = lanes -> carry[lane], current = lanes -> current[lane];
+    uint32_t prev = lanes -> prev[lane], linear = lanes -> linear[lane];
+    uint32_t first = LANES_NEXT_LINEAR(linear), second = LANES_NEXT_LINEAR(first);
+    uint32_t third = LANES_NEXT_LINEAR(second), fourth = LANES_NEXT_LINEAR(third);
+    uint32_t mask = LANES_MASK(!shift);
+    shift = LANES_SELECT(mask, (first << 24) | ((second & 0xff) << 16) | ((third & 0xff) << 8) | (fourth & 0xff), shift);
+    linear = LANES_SELECT(mask, fourth, linear);
+    shift ^= shift >> 8;
+    shift ^= shift << 9;
+    shift ^= shift >> 23;
+    // the table loops must be unrolled for the outer loop to be vectorized, and -O2 doesn't unroll them on its own
+    // all short cycle entries have a non-zero prev, so they can only match when the original checks prev || current
+    // they are all compared against the original values, so at most one of them matches
+    uint32_t next_prev = prev, next_current = current, next_carry = carry;
+#pragma GCC unroll 16
+    for (p = 0; p < (sizeof short_cycles - 3); p += 3) {
+      mask = LANES_MASK(prev == short_cycles[p]) & LANES_MASK(current == short_cycles[p + 1]) &
+             LANES_MASK(carry == short_cycles[p + 2]);
+      next_prev = LANES_SELECT(mask, short_cycles[p + 3], next_prev);
+      next_current = LANES_SELECT(mask, short_cycles[p + 4], next_current);
+      next_carry = LANES_SELECT(mask, short_cycles[p + 5], next_carry);
+    }
+    uint32_t empty = LANES_MASK(!(prev | current));
+#pragma GCC unroll 16
+    for (p = 0; p < (sizeof cycle_start_points - 1); p ++)
+      next_carry = LANES_SELECT(empty & LANES_MASK(carry == cycle_start_points[p]), cycle_start_points[p + 1], next_carry);
+    // the last start point leads into the first short cycle
+    mask = empty & LANES_MASK(carry == cycle_start_points[sizeof cycle_start_points - 2]);
+    prev = LANES_SELECT(mask, *short_cycles, next_prev);
+    current = LANES_SELECT(mask, short_cycles[1], next_current);
+    carry = LANES_SELECT(mask, short_cycles[2], next_carry);
+    linear = LANES_SELECT(mask, LANES_NEXT_LINEAR(linear), linear);
+    carry -= LANES_MASK(carry >= 210) & 210;
+    p = carry + prev + current;
+    mask = LANES_MASK(!p) | LANES_MASK(p == 719);
+    first = LANES_NEXT_LINEAR(linear);
+    second = LANES_NEXT_LINEAR(first);
+    third = LANES_NEXT_LINEAR(second);
+    prev = LANES_SELECT(mask, first & 0xff, prev);
+    carry = LANES_SELECT(mask, second & 0xff, carry);
+    current = LANES_SELECT(mask, third & 0xff, current);
+    linear = LANES_SELECT(mask, third, linear);
+    p = 210 * prev + carry;
+    prev = current;
+    current = p & 0xff;
+    carry = p >> 8;
+    linear = LANES_NEXT_LINEAR(linear);
+    p = shift >> ((linear >> 3) & 24);
+    mask = (linear >> 4) & 3;
+    p = LANES_SELECT(LANES_MASK(!mask), p + current, LANES_SELECT(LANES_MASK(mask == 1), p ^ current,
+        LANES_SELECT(LANES_MASK(mask == 2), p - current, current - p)));
+    result[lane] = p & 0xff;
+    lanes -> shift[lane] = shift;
+    lanes -> carry[lane] = carry;
+    lanes -> current[lane] = current;
+    lanes -> prev[lane] = prev;
+    lanes -> linear[lane] = linear & 0xff;
+  }
+}
+
+static inline void libsrng_random_halfword_lanes (struct libsrng_lanes * restrict lanes, uint16_t * restrict result) {
+  uint32_t first[LANE_COUNT], second[LANE_COUNT], third[LANE_COUNT];
+  unsigned lane, count;
+  for (lane = 0; lane < LANE_COUNT; lane ++) {
+    uint64_t state = ((uint64_t) lanes -> shift[lane]) | ((uint64_t) lanes -> carry[lane] << 32) |
+                     ((uint64_t) lanes -> current[lane] << 40) | ((uint64_t) lanes -> prev[lane] << 48) |
+                     ((uint64_t) lanes -> linear[lane] << 56);
+    state = (state == SWITCH_TRIGGER_STATE_0) ? SWITCH_TRIGGER_STATE_1 :
+            (state == SWITCH_TRIGGER_STATE_1) ? SWITCH_TRIGGER_STATE_2 :
+            (state == SWITCH_TRIGGER_STATE_2) ? SWITCH_TRIGGER_STATE_0 : state;
+    lanes -> shift[lane] = state;
+    lanes -> carry[lane] = (state >> 32) & 0xff;
+    lanes -> current[lane] = (state >> 40) & 0xff;
+    lanes -> prev[lane] = (state >> 48) & 0xff;
+    lanes -> linear[lane] = state >> 56;
+  }
+  libsrng_stable_random_lanes(lanes, first);
+  libsrng_stable_random_lanes(lanes, second);
+  libsrng_stable_random_lanes(lanes, third);
+  for (lane = 0; lane < LANE_COUNT; lane ++) {
+    uint32_t buffer = (first[lane] << 8) | second[lane];
+    uint32_t shift = third[lane] >> 4, multiplier = 3 + ((third[lane] & 12) >> 1), iterations = (third[lane] & 3) + 2;
+    // always run the maximum number of iterations (5) and discard the extra ones
+#pragma GCC unroll 8
+    for (count = 0; count < 5; count ++) buffer = (count < iterations) ? libsrng_random_linear(buffer) : buffer;
+    buffer = ((buffer << shift) | (buffer >> (16 - shift))) & 0xffff;
+    result[lane] = buffer * multiplier;
+  }
+}
+
+static inline void libsrng_random_seed_lanes (struct libsrng_lanes * restrict lanes, uint64_t * restrict result) {
+  // same as libsrng_random_seed, for each lane
+  uint32_t bytes[LANE_COUNT];
+  uint16_t halfwords[LANE_COUNT];
+  uint64_t second[LANE_COUNT];
+  unsigned lane, count;
+  for (lane = 0; lane < LANE_COUNT; lane ++) result[lane] = second[lane] = 0;
+  for (count = 0; count < 8; count ++) {
+    libsrng_stable_random_lanes(lanes, bytes);
+    for (lane = 0; lane < LANE_COUNT; lane ++) result[lane] = (result[lane] << 8) | bytes[lane];
+  }
+  for (count = 0; count < 4; count ++) {
+    libsrng_random_halfword_lanes(lanes, halfwords);
+    for (lane = 0; lane < LANE_COUNT; lane ++) second[lane] = (second[lane] << 16) + halfwords[lane];
+  }
+  for (lane = 0; lane < LANE_COUNT; lane ++)
+    result[lane] = (result[lane] * SEED_LCG_MULTIPLIER + SEED_LCG_FIRST_ADDEND) ^
+                   (second[lane] * SEED_LCG_MULTIPLIER + SEED_LCG_SECOND_ADDEND);
+}
+
+static inline uint64_t libsrng_regular_state (uint64_t state) {
+  // maps a state to one that libsrng_stable_random won't patch up on its first step: the shift register must not be
+  // zero and the carry must be below 210 (scaling the byte keeps every carry value reachable, unlike clearing bits)
+  uint32_t shift = state;
+  shift += !shift;
+  return (state & 0xffffff0000000000ULL) | ((((state >> 32) & 0xff) * 210) >> 8 << 32) | shift;
+}
+
+static inline int libsrng_degenerate_state (uint64_t state) {
+  // states that libsrng_stable_random would fix up: the ones with a zero prev and current (which are either a fixed
+  // point or switched to another cycle when their carry is one of the cycle start points), and the ones in short
+  // cycles: the multiply-with-carry part (without its fix-ups) has four cycles of length 7 and two fixed points,
+  // besides its long cycles, and the states in those are exactly the ones that return to themselves after 7 steps,
+  // since 7 is prime (the shortest long cycle has over 200,000 states)
+  uint32_t carry = (state >> 32) & 0xff, current = (state >> 40) & 0xff, prev = (state >> 48) & 0xff, p;
+  if (!(prev | current)) return 1;
+  uint32_t initial_carry = carry, initial_current = current, initial_prev = prev;
+  unsigned count;
+  for (count = 0; count < 7; count ++) {
+    p = 210 * prev + carry;
+    prev = current;
+    current = p & 0xff;
+    carry = p >> 8;
+  }
+  return (carry == initial_carry) && (current == initial_current) && (prev == initial_prev);
+}
+
+static inline uint64_t libsrng_sequence_key (const uint64_t * seeds, size_t count) {
+  uint64_t key = count;
+  size_t current;
+  for (current = 0; current < count; current ++) key = libsrng_stream_from_id(key, seeds[current]);
+  return libsrng_counter_key(key);
+}
+
+static inline uint64_t libsrng_sequence_fix (uint64_t state) {
+  while (libsrng_degenerate_state(state)) state = libsrng_regular_state(libsrng_mix(state));
+  return state;
+}
+
+static inline uint64_t libsrng_hash_word (const unsigned char * bytes, unsigned count) {
+  // little-endian load of up to 8 bytes (compilers turn this into a single load for a full word)
+  uint64_t result = 0;
+  while (count --) result = (result << 8) | bytes[count];
+  return result;
+}
+
+static inline uint64_t libsrng_hash_key (uint64_t root, const unsigned char * key, size_t length) {
+  // any changes to this function must be reflected in the C++ constexpr version in libsrng.h
+  uint64_t lanes[4] = {root, root ^ SEED_LCG_FIRST_ADDEND, root ^ SEED_LCG_SECOND_ADDEND, ~root};
+  size_t position = 0;
+  unsigned lane;
+  // each lane takes one word out of every 32 bytes; the lanes are independent, so they can be computed in parallel
+  for (; (length - position) >= 32; position += 32)
+    for (lane = 0; lane < 4; lane ++) HASH_ROUND(lanes[lane], libsrng_hash_word(key + position + 8 * lane, 8));
+  // the remaining full words go into the lanes in order, followed by a (possibly empty) partial word
+  for (lane = 0; (length - position) >= 8; lane ++, position += 8) HASH_ROUND(lanes[lane], libsrng_hash_word(key + position, 8));
+  HASH_ROUND(lanes[lane], libsrng_hash_word(key + position, length - position));
+  uint64_t result = length * SEED_LCG_MULTIPLIER;
+  for (lane = 0; lane < 4; lane ++) result = libsrng_mix(result ^ lanes[lane]);
+  return result;
+}
+
+static inline uint64_t libsrng_pool_get (const libsrng_pool_t * pool, size_t index) {
+  return ((uint64_t) pool -> shift[index]) | ((uint64_t) pool -> carry[index] << 32) |
+         ((uint64_t) pool -> current[index] << 40) | ((uint64_t) pool -> prev[index] << 48) |
+         ((uint64_t) pool -> linear[index] << 56);
+}
+
+static inline void libsrng_pool_put (libsrng_pool_t * pool, size_t index, uint64_t state) {
+  pool -> shift[index] = state;
+  pool -> carry[index] = state >> 32;
+  pool -> current[index] = state >> 40;
+  pool -> prev[index] = state >> 48;
+  pool -> linear[index] = state >> 56;
+}
+
+static inline void libsrng_pool_step_lanes (libsrng_pool_t * pool, const size_t * indexes, size_t first, uint16_t range,
+                                            uint16_t * result) {
+  // steps LANE_COUNT states, either the ones at the given indexes or (if indexes is null) the ones starting at first
+  struct libsrng_lanes lanes;
+  uint64_t states[LANE_COUNT];
+  unsigned lane;
+  for (lane = 0; lane < LANE_COUNT; lane ++) {
+    size_t index = indexes ? indexes[lane] : first + lane;
+    lanes.shift[lane] = pool -> shift[index];
+    lanes.carry[lane] = pool -> carry[index];
+    lanes.current[lane] = pool -> current[index];
+    lanes.prev[lane] = pool -> prev[index];
+    lanes.linear[lane] = pool -> linear[index];
+  }
+  libsrng_random_halfword_lanes(&lanes, result);
+  libsrng_lanes_store(&lanes, states);
+  // range reduction rarely needs to generate more values, so it runs on the scalar generator
+  for (lane = 0; lane < LANE_COUNT; lane ++) result[lane] = libsrng_reduce_range(states + lane, result[lane], range);
+  for (lane = 0; lane < LANE_COUNT; lane ++) libsrng_pool_put(pool, indexes ? indexes[lane] : first + lane, states[lane]);
+}
+
+static inline uint64_t libsrng_permutation_round (const libsrng_permutation_t * permutation, uint64_t value) {
+  value *= SEED_LCG_MULTIPLIER;
+  value ^= value >> 31;
+  // take the top bits of the product, which depend on all bits of the input
+  return (value * SEED_LCG_MULTIPLIER) >> (64 - permutation -> half_bits);
+}
+
+static inline uint64_t libsrng_permutation_network (const libsrng_permutation_t * permutation, uint64_t value) {
+  // balanced Feistel network over 2 * half_bits bits: a bijection for any choice of round function
+  uint64_t mask = ((uint64_t) 1 << permutation -> half_bits) - 1;
+  uint64_t left = value >> permutation -> half_bits, right = value & mask, temp;
+  unsigned round;
+  for (round = 0; round < (sizeof permutation -> keys / sizeof *permutation -> keys); round ++) {
+    temp = left ^ libsrng_permutation_round(permutation, right ^ permutation -> keys[round]);
+    left = right;
+    right = temp;
+  }
+  return (left << permutation -> half_bits) | right;
+}
+
+static inline double libsrng_random_unit (uint64_t * state) {
+  uint64_t result = 0;
+  unsigned count;
+  for (count = 0; count < 4; count ++) result = (result << 16) | libsrng_random_halfword(state);
+  return (result >> 11) * 0x1p-53;
+}
+
+static inline double libsrng_piecewise_map (const libsrng_piecewise_t * distribution, double value) {
+  unsigned bin = value * distribution -> bins;
+  // rounding can push the product up to the bin count for very large tables
+  if (bin >= distribution -> bins) bin = distribution -> bins - 1;
+  bin = distribution -> guide[bin];
+  while (value >= distribution -> cdf[bin + 1]) bin ++;
+  const double * cdf = distribution -> cdf + bin;
+  double position = (value - *cdf) / (cdf[1] - *cdf);
+  if (distribution -> linear) {
+    // invert the CDF of a trapezoid: solve a * x + (b - a) * x^2 / 2 = position * (a + b) / 2 for x in [0, 1]
+    // this form of the quadratic formula avoids cancellation when a and b are close
+    double first = distribution -> densities[bin], second = distribution -> densities[bin + 1];
+    double root = first + sqrt(first * first * (1 - position) + second * second * position);
+    position = root ? position * (first + second) / root : 0;
+  }
+  const double * edges = distribution -> edges + bin;
+  return *edges + position * (edges[1] - *edges);
+}
+
+#if LIBSRNG_STATS
+static inline void libsrng_stats_count (enum libsrng_stats_counter counter, uint64_t amount) {
+#if LIBSRNG_THREADS
+  struct libsrng_stats_block * block = libsrng_stats_local;
+  if (!(block || (block = libsrng_stats_claim()))) return;
+  // only this thread writes to the block, so the counter doesn't need an atomic read-modify-write
+  atomic_store_explicit(block -> counters + counter,
+                        atomic_load_explicit(block -> counters + counter, memory_order_relaxed) + amount, memory_order_relaxed);
+#else
+  libsrng_stats_counters[counter] += amount;
+#endif
+}
+#endif
+
+#if LIBSRNG_RSEQ
+static inline int libsrng_cpu_commit (struct libsrng_cpu_slot * slot, uint64_t expected, uint64_t state) {
+  // stores state into the slot if it still contains expected and the thread is still on the slot's CPU; returns 0 if
+  // the slot changed or the thread was moved
+#if CPU_COMMIT_RSEQ
+  // restartable sequence: the kernel sends the thread to the abort handler (at 4) if it's preempted, migrated or
+  // interrupted by a signal anywhere between 1 and 2, so the comparisons and the store are atomic with respect to every
+  // thread that can access the slot, without a locked instruction; the descriptor (at 3) tells the kernel where the
+  // sequence is, and the abort handler must be preceded by the signature that glibc registered
+  struct rseq * area = (struct rseq *) ((char *) __builtin_thread_pointer() + __rseq_offset);
+  uint32_t cpu = slot - libsrng_cpu_slots;
+  __asm__ goto (
+    ".pushsection __rseq_cs, \"aw\"\n\t"
+    ".balign 32\n\t"
+    "3:\n\t"
+    ".long 0, 0\n\t"
+    ".quad 1f, (2f - 1f), 4f\n\t"
+    ".popsection\n\t"
+    "leaq 3b(%%rip), %%rax\n\t"
+    "movq %%rax, %[descriptor]\n\t"
+    "1:\n\t"
+    "cmpl %[cpu], %[current_cpu]\n\t"
+    "jne %l[aborted]\n\t"
+    "cmpq %[expected], %[slot]\n\t"
+    "jne %l[aborted]\n\t"
+    "movq %[state], %[slot]\n\t"
+    "2:\n\t"
+    ".pushsection __rseq_failure, \"ax\"\n\t"
+    // the signature is encoded as an undefined instruction, like glibc and librseq do
+    ".byte 0x0f, 0xb9, 0x3d\n\t"
+    ".long %c[signature]\n\t"
+    "4:\n\t"
+    "jmp %l[aborted]\n\t"
+    ".popsection"
+    :
+    : [descriptor] "m" (area -> rseq_cs), [current_cpu] "m" (area -> cpu_id), [cpu] "r" (cpu),
+      [slot] "m" (*(uint64_t *) &slot -> state), [expected] "r" (expected), [state] "r" (state),
+      [signature] "i" (RSEQ_SIG)
+    : "rax", "cc", "memory"
+    : aborted);
+  return 1;
+aborted:
+  return 0;
+#else
+  return atomic_compare_exchange_strong_explicit(&slot -> state, &expected, state, memory_order_relaxed,
+                                                 memory_order_relaxed);
+#endif
 }
+#endif
@@ -2,12 +2,75 @@
 
 #define ___LIBSRNG
 
+#include <stddef.h>
 #include <stdint.h>
 
+typedef struct libsrng_piecewise libsrng_piecewise_t;
+typedef struct libsrng_pool libsrng_pool_t;
+typedef struct libsrng_reseed_cache libsrng_reseed_cache_t;
+typedef struct libsrng_shared libsrng_shared_t;
+typedef struct libsrng_producer libsrng_producer_t;
+typedef struct libsrng_consumer libsrng_consumer_t;
+
+// the contents of this structure are set by libsrng_permutation_init and shouldn't be modified directly
+typedef struct {
+  uint64_t size;
+  uint64_t keys[6];
+  unsigned half_bits;
+} libsrng_permutation_t;
+
+#define LIBSRNG_SHARED_BLOCK_SIZE 256
+
+// per-thread reader of a shared stream; its contents are managed by the libsrng_shared_* functions, and the block
+// member indicates which block of the stream is currently buffered (for instance, for logging or debugging purposes)
+typedef struct {
+  libsrng_shared_t * shared;
+  uint64_t block;
+  unsigned position;
+  uint16_t buffer[LIBSRNG_SHARED_BLOCK_SIZE];
+} libsrng_shared_reader_t;
+
+// statistics for a consumer of a producer thread; a stall is a time the consumer ran out of values and had to wait
+typedef struct {
+  uint64_t pages;       // pages taken from the producer
+  uint64_t stalls;
+  uint64_t stall_time;  // total time spent waiting, in nanoseconds
+} libsrng_consumer_stats_t;
+
+// counts of internal events, for all threads together (see libsrng_stats)
+typedef struct {
+  uint64_t rejections;    // 16-bit values discarded by rejection sampling for range-limited values
+  uint64_t switches;      // states that made the generator switch to another cycle (or leave a fixed point),
+                          // including the trigger states that 16-bit values swap for one another
+  uint64_t short_cycles;  // states moved out of a short cycle
+  uint64_t reseeds;       // reseeding iterations (each reseed of libsrng_random counts as one)
+} libsrng_stats_t;
+
+#define LIBSRNG_BUFFER_SIZE 64
+
+#if defined(__cplusplus) && (__cplusplus >= 201103L)
+  #define LIBSRNG_CACHE_ALIGNED alignas(64)
+#elif defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L)
+  #define LIBSRNG_CACHE_ALIGNED _Alignas(64)
+#elif defined(__GNUC__)
+  #define LIBSRNG_CACHE_ALIGNED __attribute__((aligned(64)))
+#else
+  #define LIBSRNG_CACHE_ALIGNED
+#endif
+
+// buffered generator: a state plus a buffer of values generated ahead of time; its contents are managed by the
+// libsrng_buffered_* functions, and state is the state after generating the whole buffer (not the current state)
+typedef struct {
+  LIBSRNG_CACHE_ALIGNED uint16_t buffer[LIBSRNG_BUFFER_SIZE];
+  unsigned position;
+  uint64_t state;
+  uint64_t base;
+} libsrng_buffered_t;
+
 #ifdef __cplusplus
-  // only one declaration, so no braces
-  extern "C"
+extern "C" {
 #endif
+
 // parameters:
 // state:  pointer to 64-bit RNG state; can't be null
 // range:  range of values to generate: a value of 10 will generate values from 0 to 9. If set to 0, the RNG will not
@@ -17,4 +80,287 @@
 //         (using a different, and slower, RNG) before generating a random number. This allows for multiple sequences.
 uint16_t libsrng_random(uint64_t * state, uint16_t range, unsigned reseed);
 
+// generates a value in [0, 1) with 53 bits of precision, consuming four 16-bit values from the state
+// returns 0 if the state is null
+double libsrng_random_double(uint64_t * state);
+
+// creates a tabulated distribution over bins adjacent intervals; returns null on invalid input or allocation failure
+// edges:   bins + 1 strictly increasing finite bin boundaries (the widths of the bins must be finite as well)
+// weights: if linear is zero, bins non-negative weights, one for each bin (the density is constant within a bin);
+//          if linear is non-zero, bins + 1 non-negative densities, one for each edge (the density is interpolated
+//          linearly within each bin). In both cases, the weights need not be normalized, but they can't be all zero.
+// the returned object doesn't reference the input arrays and it must be released with libsrng_piecewise_destroy
+libsrng_piecewise_t * libsrng_piecewise_create(const double * edges, const double * weights, unsigned bins, int linear);
+void libsrng_piecewise_destroy(libsrng_piecewise_t * distribution);
+// samples one value from the distribution, consuming the same amount of random numbers as libsrng_random_double
+double libsrng_piecewise_sample(const libsrng_piecewise_t * distribution, uint64_t * state);
+// samples count values into result; equivalent to (but faster than) count calls to libsrng_piecewise_sample
+void libsrng_piecewise_sample_many(const libsrng_piecewise_t * distribution, uint64_t * state, double * result,
+                                   size_t count);
+
+// initializes a random permutation of the values from 0 to size - 1 (or of all 64-bit values if size is 0), taking
+// its keys from the state; the permutation isn't stored, but computed on demand, so it takes no additional memory
+void libsrng_permutation_init(libsrng_permutation_t * permutation, uint64_t * state, uint64_t size);
+// maps an index to its position in the permutation; indexes outside the permutation's range are returned unmodified
+uint64_t libsrng_index_to_permuted(const libsrng_permutation_t * permutation, uint64_t index);
+// maps the indexes from first to first + count - 1 into result; equivalent to calling libsrng_index_to_permuted on
+// each of those indexes, but faster
+void libsrng_index_to_permuted_many(const libsrng_permutation_t * permutation, uint64_t first, uint64_t * result,
+                                    size_t count);
+
+// counter-based generation: the values are a function of a seed and a counter, and they can be computed in any order
+// without storing or stepping any state; for a fixed seed, different counters always result in different states
+// returns a state derived from seed and counter, which can be passed to libsrng_random to generate more values
+uint64_t libsrng_at_state(uint64_t seed, uint64_t counter);
+// returns the first 16-bit value generated by the state returned by libsrng_at_state
+uint16_t libsrng_at(uint64_t seed, uint64_t counter);
+// same as above, but limited to a range, as in libsrng_random
+uint16_t libsrng_at_range(uint64_t seed, uint64_t counter, uint16_t range);
+// stores libsrng_at(seed, first + n) into result[n] for every n from 0 to count - 1
+void libsrng_at_many(uint64_t seed, uint64_t first, uint16_t * result, size_t count);
+
+// coordinate-keyed generation: fills a tile of a grid with the values for each cell, which only depend on the seed and
+// the cell's coordinates (so they don't depend on how the grid is split into tiles or on the order they are filled in)
+// the value of the cell at (x, y) is libsrng_at(libsrng_at_state(seed, y), x), and the value of the cell at (x, y, z)
+// is libsrng_at(libsrng_at_state(libsrng_at_state(seed, z), y), x); negative coordinates are converted to uint64_t
+// origin:     coordinates of the first cell of the tile, x first
+// dimensions: size of the tile along each axis, x first
+// result:     output buffer, with one value per cell; x varies fastest, then y, then z
+void libsrng_fill_grid2d(uint64_t seed, const int64_t origin[2], const uint32_t dimensions[2], uint16_t * result);
+void libsrng_fill_grid3d(uint64_t seed, const int64_t origin[3], const uint32_t dimensions[3], uint16_t * result);
+
+// splits a stream: returns a new state for a child stream and advances the parent state, using only a few arithmetic
+// operations (much cheaper than reseeding with libsrng_random)
+// the child state is a bijective function of the parent state, so different parent states always result in different
+// children, and the parent advances through a sequence of period 2^64, so repeatedly splitting the same stream doesn't
+// repeat children until it has been split 2^64 times; the mixing function makes children statistically independent of
+// their parent and of each other for simulation purposes (but not for cryptographic ones)
+// returns 0 if the parent is null
+uint64_t libsrng_split(uint64_t * parent);
+
+// keyed streams: derive a state from a root state and a key in a single pass over the key, so that every stream can
+// be identified by a name or an ID; different keys result in unrelated states
+// returns a state derived from root and the length bytes at key (a null key is treated as an empty one)
+uint64_t libsrng_stream_from_key(uint64_t root, const void * key, size_t length);
+// same as calling libsrng_stream_from_key with the 8 bytes of id in little-endian order as the key
+uint64_t libsrng_stream_from_id(uint64_t root, uint64_t id);
+// derives a state from each component of a path in turn: for instance, "world/region/42" results in the same state
+// as deriving a state for "world" from root, then for "region" from that state, and so on; the components are
+// separated by slashes, and empty components are ignored (so a null or empty path returns root unchanged)
+uint64_t libsrng_stream_from_path(uint64_t root, const char * path);
+
+// reseed caches: store the states obtained by reseeding a root state every interval times, up to some limit, so that
+// reseeding the root state any number of times takes at most interval - 1 reseeds (as long as the number is within
+// the limit); caches are stored in a flat buffer, which can be in memory or in a memory-mapped file
+// returns the size in bytes of the buffer needed for a cache with the given parameters, or 0 if interval is 0
+size_t libsrng_reseed_cache_size(unsigned interval, unsigned limit);
+// builds a cache in the buffer (which must be suitably aligned for a uint64_t), taking limit reseeds in total, and
+// returns it; returns null if the parameters are invalid or the buffer is too small
+// the buffer can hold an earlier cache, which is invalidated first, so that an interrupted rebuild is never accepted
+const libsrng_reseed_cache_t * libsrng_reseed_cache_build(void * buffer, size_t size, uint64_t root, unsigned interval,
+                                                          unsigned limit);
+// validates a buffer that contains a cache built earlier (for instance, a memory-mapped file) and returns the cache,
+// or null if the buffer doesn't contain a valid cache
+const libsrng_reseed_cache_t * libsrng_reseed_cache_attach(const void * buffer, size_t size);
+// returns the state that results from reseeding the cache's root state reseed times
+uint64_t libsrng_reseed_cache_state(const libsrng_reseed_cache_t * cache, unsigned reseed);
+// same as libsrng_random, but uses the cache to reseed if the state is the cache's root state (cache may be null)
+uint16_t libsrng_random_cached(const libsrng_reseed_cache_t * cache, uint64_t * state, uint16_t range, unsigned reseed);
+
+// expands seed_count seeds into count states, all of them different for different combinations of seeds; the states
+// are never degenerate (i.e., none of them need to be fixed by the generator, and none of them are in short cycles)
+// the states only depend on the seeds and their position, so a longer expansion starts with a shorter one
+void libsrng_seed_seq(const uint64_t * seeds, size_t seed_count, uint64_t * states, size_t count);
+
+// reseeds count states at once: children[n] is set to the state that libsrng_random(&state, 1, depth) would leave in a
+// state initialized to parents[n]; parents and children may be the same array, but they must not overlap otherwise
+void libsrng_seed_many(const uint64_t * parents, uint64_t * children, size_t count, unsigned depth);
+
+// thread-local generators: every thread has its own state, initialized the first time the thread uses it from the
+// process seed and an ordinal number assigned to the thread at that point (the n-th thread to use its state since the
+// process seed was last set gets the state at index n - 1 of the expansion of the process seed by libsrng_seed_seq);
+// no locks are involved
+// these functions are only available if libsrng.c is compiled as C11 (or later) with support for threads and atomics
+// sets the process seed (0 by default), which affects the calling thread and threads that haven't used their state yet,
+// and restarts the ordinals: the calling thread's state is set to the first state of the expansion immediately (even if
+// other threads take their states before it uses it), so that seeding and then generating values in the same thread is
+// reproducible; threads that already used their state keep it, so setting
+// a seed that was already used can make new threads repeat the states of those threads
+void libsrng_tl_seed(uint64_t seed);
+// returns a pointer to the calling thread's state, which can be passed to any other function in the library
+uint64_t * libsrng_tl_state(void);
+// same as libsrng_random(libsrng_tl_state(), range, 0)
+uint16_t libsrng_tl_random(uint16_t range);
+// same as libsrng_random_double(libsrng_tl_state())
+double libsrng_tl_double(void);
+
+// per-CPU generators: a single state for each CPU, shared by all threads that run on it, so that memory use doesn't
+// grow with the number of threads; they use Linux's rseq to find the current CPU and (on x86-64) to update its state in
+// a restartable sequence, without atomic instructions (elsewhere, they use a compare-and-swap), and fall back to the
+// thread-local generators above when rseq isn't available; libsrng_cpu_seed also reseeds the calling thread's
+// thread-local state, and it must not be called while other threads are using these generators
+void libsrng_cpu_seed(uint64_t seed);
+uint16_t libsrng_cpu_random(uint16_t range);
+double libsrng_cpu_double(void);
+
+// shared streams: a single stream, split into blocks of LIBSRNG_SHARED_BLOCK_SIZE 16-bit values, which threads reserve
+// through their own readers with a single atomic operation; every block always contains the same values, no matter
+// which thread reserves it, but blocks are assigned to threads in the order they request them
+// these functions have the same requirements as the thread-local generators above
+// creates a shared stream (returning null on failure), which must be destroyed after all readers stop using it
+libsrng_shared_t * libsrng_shared_create(uint64_t seed);
+void libsrng_shared_destroy(libsrng_shared_t * shared);
+// initializes a reader for a shared stream; every thread must use its own reader
+void libsrng_shared_reader_init(libsrng_shared_reader_t * reader, libsrng_shared_t * shared);
+// takes a value from the reader's block, reserving a new block if needed; range works like in libsrng_random
+uint16_t libsrng_shared_random(libsrng_shared_reader_t * reader, uint16_t range);
+
+// producer threads: a background thread that keeps pages of values generated ahead of time for any number of consumers,
+// so that consumers never generate values themselves (unless they outrun the producer); each consumer generates the
+// same values as calling libsrng_random on its state directly, in the same order; when every consumer's pages are full,
+// the thread sleeps until a consumer takes a page, so an idle producer doesn't keep a CPU busy
+// these functions have the same requirements as the thread-local generators above
+// creates a producer thread with count consumers, one for each of the states; returns null on failure
+libsrng_producer_t * libsrng_producer_create(const uint64_t * states, size_t count);
+// stops the thread and destroys the producer and its consumers, which must no longer be in use
+void libsrng_producer_destroy(libsrng_producer_t * producer);
+// returns the consumer for the state at index; each consumer must only be used by one thread at a time
+libsrng_consumer_t * libsrng_producer_consumer(libsrng_producer_t * producer, size_t index);
+// same as libsrng_random(&state, range, 0), for the consumer's state
+uint16_t libsrng_consumer_random(libsrng_consumer_t * consumer, uint16_t range);
+// the statistics can be read from any thread, but they are only updated when the consumer takes a new page
+void libsrng_consumer_stats(const libsrng_consumer_t * consumer, libsrng_consumer_stats_t * stats);
+
+// buffered generators: they generate the same values as calling libsrng_random on the state directly, in the same
+// order, but they generate values in bulk, so that the inline functions below only need a call to refill the buffer
+// initializes a buffered generator from a state; the state itself isn't modified
+void libsrng_buffered_init(libsrng_buffered_t * buffered, uint64_t state);
+// returns the state that the values taken from the buffered generator so far would have left behind if they had been
+// generated directly (i.e., the state to use to continue the same sequence without the buffered generator)
+uint64_t libsrng_buffered_state(const libsrng_buffered_t * buffered);
+// generates LIBSRNG_BUFFER_SIZE new values; the inline functions call it automatically when the buffer runs out
+void libsrng_buffered_refill(libsrng_buffered_t * buffered);
+
+// call traces: while a trace is being recorded, every call to libsrng_random appends its range and reseed count to the
+// trace file (but not the state, so that traces don't reveal any values), which benchmark/replay.c can replay
+// these functions are only available if libsrng.c is compiled with LIBSRNG_TRACE defined to 1; starting or stopping a
+// trace must not race with calls to libsrng_random in other threads
+// starts recording into filename, replacing its contents; returns 0 if a trace is already being recorded or on failure
+int libsrng_trace_start(const char * filename);
+// stops recording and closes the trace file; returns 0 if no trace was being recorded or if writing the file failed
+int libsrng_trace_stop(void);
+
+// statistics: totals of the internal events counted so far by every thread (including threads that already exited),
+// which show how much work the library does beyond generating values; every thread counts into its own counters, so
+// that counting never contends, and they are only added up when this function is called
+// this function is only available if libsrng.c is compiled with LIBSRNG_STATS defined to 1; without support for
+// threads (see the thread-local generators), the counters aren't thread-safe
+// events in the inline functions of buffered generators and in the vectorized kernels (see LIBSRNG_LANES) aren't
+// counted, except for reseeds and rejections in bulk functions
+void libsrng_stats(libsrng_stats_t * stats);
+
+// state pools: many states, stored split by field so that they can be stepped in parallel
+// creates a pool with count states, initialized from states (or to zero if states is null); returns null on failure
+libsrng_pool_t * libsrng_pool_create(const uint64_t * states, size_t count);
+void libsrng_pool_destroy(libsrng_pool_t * pool);
+size_t libsrng_pool_size(const libsrng_pool_t * pool);
+// copy count states, starting at index first in the pool, to or from the regular 64-bit format
+// the conversions are lossless; ranges that don't fit within the pool are ignored
+void libsrng_pool_import(libsrng_pool_t * pool, size_t first, const uint64_t * states, size_t count);
+void libsrng_pool_export(const libsrng_pool_t * pool, size_t first, uint64_t * states, size_t count);
+// for each of the count indexes, stores into result[n] the value that libsrng_random(&state, range, 0) would generate
+// for the state at indexes[n], updating the state accordingly; indexes must be valid and they must not repeat
+void libsrng_pool_step(libsrng_pool_t * pool, const size_t * indexes, size_t count, uint16_t range, uint16_t * result);
+// same as above, for every state in the pool; result must have room for libsrng_pool_size(pool) values
+void libsrng_pool_step_all(libsrng_pool_t * pool, uint16_t range, uint16_t * result);
+
+// same as libsrng_random(&state, 0, 0)
+static inline uint16_t libsrng_buffered_next16 (libsrng_buffered_t * buffered) {
+  if (buffered -> position >= LIBSRNG_BUFFER_SIZE) libsrng_buffered_refill(buffered);
+  return buffered -> buffer[buffered -> position ++];
+}
+
+// combines two consecutive 16-bit values, the first one in the high half of the result (like the rest of the library
+// does when it combines values, so that two calls make up the same 64-bit value as libsrng_random_double uses)
+static inline uint32_t libsrng_buffered_next32 (libsrng_buffered_t * buffered) {
+  uint32_t result = (uint32_t) libsrng_buffered_next16(buffered) << 16;
+  return result | libsrng_buffered_next16(buffered);
+}
+
+// same as libsrng_random(&state, range, 0)
+static inline uint16_t libsrng_buffered_next_range (libsrng_buffered_t * buffered, uint16_t range) {
+  if (range == 1) return 0;
+  uint16_t result = libsrng_buffered_next16(buffered);
+  if (!(range & (range - 1))) return result & (range - 1);
+  // must match the rejection done by libsrng_random
+  uint16_t resampling_limit = 0x10000 % range;
+  if (result < range) while (result < resampling_limit) result = libsrng_buffered_next16(buffered);
+  return result % range;
+}
+
+#ifdef __cplusplus
+}
+
+#if __cplusplus >= 201402L
+// compile-time versions of libsrng_stream_from_key and libsrng_stream_from_path for string literals (the terminating
+// null character isn't part of the key); they return the same values as the runtime functions
+namespace libsrng_constexpr {
+  // these constants and functions must match the ones used by libsrng.c
+  constexpr uint64_t seed_lcg_multiplier = 0x5851f42d4c957f2dULL;
+  constexpr uint64_t seed_lcg_first_addend = 0x0123456789abcdefULL;
+  constexpr uint64_t seed_lcg_second_addend = 0x0fedcba987654321ULL;
+
+  constexpr uint64_t mix (uint64_t value) {
+    value ^= value >> 32;
+    value *= seed_lcg_multiplier;
+    value ^= value >> 29;
+    value *= seed_lcg_multiplier;
+    return value ^ (value >> 32);
+  }
+
+  constexpr uint64_t hash_round (uint64_t value, uint64_t word) {
+    value = (value ^ word) * seed_lcg_multiplier;
+    return (value << 31) | (value >> 33);
+  }
+
+  constexpr uint64_t word (const char * bytes, size_t count) {
+    uint64_t result = 0;
+    while (count --) result = (result << 8) | static_cast<unsigned char>(bytes[count]);
+    return result;
+  }
+
+  constexpr uint64_t hash (uint64_t root, const char * key, size_t length) {
+    uint64_t lanes[4] = {root, root ^ seed_lcg_first_addend, root ^ seed_lcg_second_addend, ~root};
+    size_t position = 0;
+    unsigned lane = 0;
+    for (; (length - position) >= 32; position += 32)
+      for (lane = 0; lane < 4; lane ++) lanes[lane] = hash_round(lanes[lane], word(key + position + 8 * lane, 8));
+    for (lane = 0; (length - position) >= 8; lane ++, position += 8) lanes[lane] = hash_round(lanes[lane], word(key + position, 8));
+    lanes[lane] = hash_round(lanes[lane], word(key + position, length - position));
+    uint64_t result = length * seed_lcg_multiplier;
+    for (lane = 0; lane < 4; lane ++) result = mix(result ^ lanes[lane]);
+    return result;
+  }
+
+  constexpr uint64_t path (uint64_t root, const char * text, size_t length) {
+    size_t position = 0, component = 0;
+    while (position < length) {
+      for (component = 0; ((position + component) < length) && (text[position + component] != '/'); component ++);
+      if (component) root = hash(root, text + position, component);
+      position += component + 1;
+    }
+    return root;
+  }
+}
+
+template <size_t length> constexpr uint64_t libsrng_stream_from_literal (uint64_t root, const char (&key)[length]) {
+  return libsrng_constexpr::hash(root, key, length - 1);
+}
+
+template <size_t length> constexpr uint64_t libsrng_stream_from_path_literal (uint64_t root, const char (&path)[length]) {
+  return libsrng_constexpr::path(root, path, length - 1);
+}
+#endif
+#endif
+
 #endif